@@ -1,6 +1,10 @@
 #include "..//..//Noodles/implement.h"
+#include "..//..//Noodles/implement/platform.h"
 #include <random>
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <optional>
 #include <math.h>
 #include <Windows.h>
 
@@ -47,6 +51,23 @@ template<typename Type> struct CallRecord
 	}
 };
 
+// elapsed time of a benchmark step
+struct TimeRecord
+{
+	TimeRecord(std::string name, size_t count) : m_name(std::move(name)), m_count(count), m_start(std::chrono::steady_clock::now()) {}
+
+	~TimeRecord()
+	{
+		auto dura = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start);
+		std::lock_guard lg(cout_mutex);
+		std::cout << "benchmark " << m_name << " : " << m_count << " in " << dura.count() << "us" << std::endl;
+	}
+private:
+	std::string m_name;
+	size_t m_count;
+	std::chrono::steady_clock::time_point m_start;
+};
+
 struct DieEvent { size_t index; };
 
 
@@ -55,33 +76,37 @@ struct MoveSystem
 	void operator()(Filter<Location, Velocity, const Collision>& f, Context& c)
 	{
 		CallRecord<MoveSystem> record;
-		for (auto ite : f)
-		{
-			auto [lo, ve, col] = ite;
-			lo.x += ve.x * c.duration_s();
-			lo.y += ve.y * c.duration_s();
-			if ((lo.x - col.Range) < -1.0f)
-			{
-				lo.x = col.Range - 1.0f;
-				ve.x = -ve.x;
-			}
-			else if ((lo.x + col.Range) > 1.0f)
-			{
-				lo.x = 1.0f - col.Range;
-				ve.x = -ve.x;
-			}
-			if ((lo.y - col.Range) < -1.0f)
-			{
-				lo.y = col.Range - 1.0f;
-				ve.y = -ve.y;
-			}
-			else if ((lo.y + col.Range) > 1.0f)
+		float duration = c.duration_s();
+		f.for_each_chunk([&](size_t count, ComponentSpan<Location> los, ComponentSpan<Velocity> ves, ComponentSpan<const Collision> cols, EntitySpan) {
+			for (size_t i = 0; i < count; ++i)
 			{
-				lo.y = 1.0f - col.Range;
-				ve.y = -ve.y;
+				auto& lo = los[i];
+				auto& ve = ves[i];
+				auto& col = cols[i];
+				lo.x += ve.x * duration;
+				lo.y += ve.y * duration;
+				if ((lo.x - col.Range) < -1.0f)
+				{
+					lo.x = col.Range - 1.0f;
+					ve.x = -ve.x;
+				}
+				else if ((lo.x + col.Range) > 1.0f)
+				{
+					lo.x = 1.0f - col.Range;
+					ve.x = -ve.x;
+				}
+				if ((lo.y - col.Range) < -1.0f)
+				{
+					lo.y = col.Range - 1.0f;
+					ve.y = -ve.y;
+				}
+				else if ((lo.y + col.Range) > 1.0f)
+				{
+					lo.y = 1.0f - col.Range;
+					ve.y = -ve.y;
+				}
 			}
-
-		}
+		});
 	}
 };
 
@@ -172,8 +197,282 @@ struct Temporary2
 };
 
 
-int main()
+constexpr size_t benchmark_count = 100000;
+
+// the same entities recorded from more and more threads, each thread appends to its own command buffer
+struct RecordBenchmark
+{
+	void operator()(Context& c)
+	{
+		if ((m_frame++ % 2) == 1)
+		{
+			c.destory_all<Location, Velocity>();
+			return;
+		}
+		if (m_thread_count > 8)
+		{
+			c.exit();
+			return;
+		}
+		std::vector<std::thread> threads(m_thread_count);
+		{
+			TimeRecord record("record threads=" + std::to_string(m_thread_count), benchmark_count);
+			for (auto& ite : threads)
+			{
+				ite = std::thread([&c, count = benchmark_count / m_thread_count]() {
+					for (size_t i = 0; i < count; ++i)
+					{
+						auto entity = c.create_entity();
+						c.create_component<Location>(entity, 0.0f, 0.0f);
+						c.create_component<Velocity>(entity, 0.0f, 0.0f);
+					}
+				});
+			}
+			for (auto& ite : threads)
+				ite.join();
+		}
+		m_thread_count *= 2;
+	}
+private:
+	size_t m_frame = 0;
+	size_t m_thread_count = 1;
+};
+
+// entities created one by one against a single batch, apply is the update between two frames which moves them into type groups
+struct BatchBenchmark
+{
+	void operator()(Context& c)
+	{
+		m_apply.reset();
+		switch (m_frame++)
+		{
+		case 0:
+		{
+			TimeRecord record("create_entity record", benchmark_count);
+			for (size_t i = 0; i < benchmark_count; ++i)
+			{
+				auto entity = c.create_entity();
+				c.create_component<Location>(entity, 0.0f, 0.0f);
+				c.create_component<Velocity>(entity, 0.0f, 0.0f);
+			}
+			m_apply.emplace("create_entity apply", benchmark_count);
+			break;
+		}
+		case 2:
+		{
+			TimeRecord record("create_entities record", benchmark_count);
+			c.create_entities<Location, Velocity>(benchmark_count);
+			m_apply.emplace("create_entities apply", benchmark_count);
+			break;
+		}
+		case 1:
+		case 3:
+			c.destory_all<Location, Velocity>();
+			break;
+		default:
+			c.exit();
+			break;
+		}
+	}
+private:
+	size_t m_frame = 0;
+	std::optional<TimeRecord> m_apply;
+};
+
+// disjoint type groups of the same shape, their structural changes can be applied apart
+template<size_t i> struct BenchGroup
+{
+	float value;
+};
+
+constexpr size_t bench_group_count = 8;
+
+// Velocity is added to every entity of every group, apply is the update between two frames which moves them into new type groups
+struct ApplyBenchmark
+{
+	ApplyBenchmark(size_t worker_count) : m_worker_count(worker_count) {}
+	void operator()(Filter<const Location>& f, Context& c)
+	{
+		m_apply.reset();
+		switch (m_frame++)
+		{
+		case 0:
+			create_groups(c, std::make_index_sequence<bench_group_count>{});
+			break;
+		case 1:
+		{
+			size_t count = 0;
+			for (auto& ite : f)
+			{
+				c.create_component<Velocity>(ite.entity(), 0.1f, 0.2f);
+				++count;
+			}
+			m_apply.emplace("apply workers=" + std::to_string(m_worker_count), count);
+			break;
+		}
+		default:
+			c.exit();
+			break;
+		}
+	}
+private:
+	template<size_t ...i> static void create_groups(Context& c, std::index_sequence<i...>)
+	{
+		(c.create_entities<Location, BenchGroup<i>>(benchmark_count / bench_group_count), ...);
+	}
+	size_t m_worker_count;
+	size_t m_frame = 0;
+	std::optional<TimeRecord> m_apply;
+};
+
+// the same kernel through the element iterator, chunks and chunks shared with idle threads
+struct ChunkBenchmark
+{
+	void operator()(Filter<Location, const Velocity>& f, Context& c)
+	{
+		constexpr size_t repeat = 20;
+		if (m_frame++ == 0)
+		{
+			c.create_entities<Location, Velocity>(benchmark_count, [](Entity, Location& l, Velocity& v) { v = { 0.1f, 0.2f }; });
+			return;
+		}
+		{
+			TimeRecord record("for_each element", benchmark_count * repeat);
+			for (size_t r = 0; r < repeat; ++r)
+			{
+				for (auto& ite : f)
+				{
+					auto& [l, v] = ite;
+					l.x += v.x * 0.01f;
+					l.y += v.y * 0.01f;
+				}
+			}
+		}
+		auto kernel = [](size_t count, ComponentSpan<Location> ls, ComponentSpan<const Velocity> vs, EntitySpan) {
+			for (size_t i = 0; i < count; ++i)
+			{
+				ls[i].x += vs[i].x * 0.01f;
+				ls[i].y += vs[i].y * 0.01f;
+			}
+		};
+		{
+			TimeRecord record("for_each_chunk", benchmark_count * repeat);
+			for (size_t r = 0; r < repeat; ++r)
+				f.for_each_chunk(kernel);
+		}
+		{
+			TimeRecord record("parallel_for_each", benchmark_count * repeat);
+			for (size_t r = 0; r < repeat; ++r)
+				f.parallel_for_each(kernel);
+		}
+		c.exit();
+	}
+private:
+	size_t m_frame = 0;
+};
+
+// a failed check makes main return non-zero
+std::atomic_bool check_failed = false;
+
+void check(bool result, const char* name)
+{
+	std::lock_guard lg(cout_mutex);
+	std::cout << "check " << name << " : " << (result ? "ok" : "failed") << std::endl;
+	if (!result)
+		check_failed = true;
+}
+
+// EntityFilter skips an entity with a disabled component, as the iteration of Filter does
+struct EnableCheck
+{
+	void operator()(Filter<const Location>& f, EntityFilter<Location, Velocity>& ef, Context& c)
+	{
+		if (m_frame++ == 0)
+		{
+			c.create_entities<Location, Velocity>(2);
+			return;
+		}
+		std::vector<Entity> entitys;
+		for (auto& ite : f)
+			entitys.push_back(ite.entity());
+		size_t called[2] = { 0, 0 };
+		if (entitys.size() == 2)
+		{
+			ef.set_enable<Velocity>(entitys[0], false);
+			for (size_t i = 0; i < 2; ++i)
+				ef(entitys[i], [&](Location&, Velocity&) { ++called[i]; });
+		}
+		check(entitys.size() == 2 && called[0] == 0 && called[1] == 1, "EntityFilter with disabled component");
+		c.exit();
+	}
+private:
+	size_t m_frame = 0;
+};
+
+// destory_component reports whether the component was held at the call, the queued removal is not seen until the next update
+struct DestoryCheck
+{
+	void operator()(Filter<const Location>& f, Context& c)
+	{
+		switch (m_frame++)
+		{
+		case 0:
+			c.create_entities<Location>(1);
+			break;
+		case 1:
+			for (auto& ite : f)
+			{
+				Entity entity = ite.entity();
+				bool first = c.destory_component<Location>(entity);
+				bool second = c.destory_component<Location>(entity);
+				check(first && second, "destory_component twice in a tick");
+				m_entity = entity;
+			}
+			break;
+		default:
+			check(m_entity && !c.destory_component<Location>(m_entity), "destory_component after the update");
+			c.exit();
+			break;
+		}
+	}
+private:
+	size_t m_frame = 0;
+	Entity m_entity;
+};
+
+template<typename SystemT, typename ...Parameter> void run_system(size_t thread_reserved, Parameter&& ...pa)
+{
+	ContextImplement imp;
+	imp.set_thread_reserved(thread_reserved);
+	imp.create_system<SystemT>(std::forward<Parameter>(pa)...);
+	imp.loop();
+}
+
+// the thread reserved count which leaves worker_count threads beside the loop thread
+size_t reserved_for_workers(size_t worker_count)
 {
+	size_t platform_thread_count = platform_info::instance().cpu_count() * 2 + 2;
+	return worker_count < platform_thread_count ? platform_thread_count - worker_count : platform_thread_count;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && std::string_view{ argv[1] } == "benchmark")
+	{
+		run_system<RecordBenchmark>(2);
+		run_system<BatchBenchmark>(2);
+		for (size_t worker_count : { 0, 1, 2, 4, 8 })
+			run_system<ApplyBenchmark>(reserved_for_workers(worker_count), worker_count);
+		run_system<ChunkBenchmark>(2);
+		return 0;
+	}
+
+	if (argc > 1 && std::string_view{ argv[1] } == "check")
+	{
+		run_system<EnableCheck>(2);
+		run_system<DestoryCheck>(2);
+		return check_failed ? 1 : 0;
+	}
 
 	{
 
@@ -60,7 +60,7 @@ struct FoodFlag {};
 
 struct RenderSystem
 {
-	void operator()(Filter<const Collision, const Location>& f, GobalFilter<Dx11::FormRenderer>& render)
+	void operator()(Filter<const Collision, const Location>& f, GobalFilter<Dx11::FormRenderer>& render, Context& ecs)
 	{
 		CallRecord<RenderSystem> record;
 		if (render->ready_to_update())
@@ -75,7 +75,7 @@ struct RenderSystem
 					float lx, ly;
 					float range, pro;
 				};
-				std::vector<Poi> data;
+				std::pmr::vector<Poi> data(ecs.frame_allocator());
 				data.resize(count);
 				size_t i = 0;
 				for (auto ite = f.begin(); ite != f.end(); ++ite)
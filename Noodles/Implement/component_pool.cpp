@@ -1,8 +1,14 @@
 #include "component_pool.h"
+#include "platform.h"
 #include "../../Potato/tool.h"
+#include <algorithm>
 namespace Noodles::Implement
 {
-	static constexpr size_t min_page_comp_count = 32;
+	namespace
+	{
+		// tells pools apart when a new one reuses the address of a destoried one
+		std::atomic_size_t pool_serial = 0;
+	}
 
 	bool TypeLayoutArray::operator<(const TypeLayoutArray& input) const noexcept
 	{
@@ -28,8 +34,8 @@ namespace Noodles::Implement
 		{
 			for (size_t i = 0; i < count; ++i)
 				if (layouts[i] != input[i])
-					return true;
-			return false;
+					return false;
+			return true;
 		}
 		else
 			return false;
@@ -73,6 +79,17 @@ namespace Noodles::Implement
 		return i;
 	}
 
+	uint64_t TypeLayoutArray::hash() const noexcept
+	{
+		uint64_t result = 14695981039346656037ull;
+		for (size_t i = 0; i < count; ++i)
+		{
+			result = (result ^ layouts[i].hash_code) * 1099511628211ull;
+			result = (result ^ layouts[i].size) * 1099511628211ull;
+		}
+		return result;
+	}
+
 	bool TypeLayoutArray::locate_unordered(const TypeInfo* input, size_t* output, size_t length) const noexcept
 	{
 		for (size_t i = 0; i < length; ++i)
@@ -86,21 +103,26 @@ namespace Noodles::Implement
 		return true;
 	}
 
-	StorageBlock* create_storage_block(MemoryPageAllocator& allocator, const TypeGroup* owner)
+	StorageBlock* create_storage_block(MemoryPageAllocator& allocator, TypeGroup* owner)
 	{
 		auto [buffer, page_size] = allocator.allocate(owner->page_size());
 		assert(page_size == owner->page_size());
 		size_t element_count = owner->element_count();
 		auto [layouts, layout_count] = owner->layouts();
+		size_t column_align = owner->column_align();
 		StorageBlock* result = new (buffer) StorageBlock{};
 		result->m_owner = owner;
+		result->capacity = element_count;
+		result->functions = owner->functions();
 		result->datas = reinterpret_cast<void**>(result + 1);
 		buffer = reinterpret_cast<std::byte*>(result->datas + layout_count);
 		page_size -= sizeof(StorageBlock) +  sizeof(void*) * layout_count;
 		for (size_t i = 0; i < layout_count; ++i)
 		{
+			if (layouts[i].tag)
+				continue;
 			void* ptr = buffer;
-			auto result_r = std::align(layouts[i].align, layouts[i].size * element_count, ptr, page_size);
+			auto result_r = std::align(std::max(layouts[i].align, column_align), layouts[i].size * element_count, ptr, page_size);
 			assert(result_r != nullptr);
 			result->datas[i] = ptr;
 			buffer = reinterpret_cast<std::byte*>(ptr);
@@ -110,19 +132,33 @@ namespace Noodles::Implement
 
 		{
 			void* ptr = buffer;
-			std::align(alignof(EntityInterface*), sizeof(EntityInterface*), ptr, page_size);
+			std::align(alignof(uint32_t), sizeof(uint32_t), ptr, page_size);
 			buffer = reinterpret_cast<std::byte*>(ptr);
 		}
-		result->entitys = reinterpret_cast<EntityInterface * *>(buffer);
+		result->entitys = reinterpret_cast<uint32_t*>(buffer);
 		for (size_t i = 0; i < element_count; ++i)
-			result->entitys[i] = nullptr;
+			result->entitys[i] = EntityId::invalid_index;
 		buffer = reinterpret_cast<std::byte*>(result->entitys + element_count);
-		result->functions = reinterpret_cast<StorageBlockFunctionPair * *>(buffer);
-		StorageBlockFunctionPair* tem_ptr = reinterpret_cast<StorageBlockFunctionPair*>(result->functions + layout_count);
+		// tags are never read or written, iterators only need an address inside the block
 		for (size_t i = 0; i < layout_count; ++i)
+			if (layouts[i].tag)
+				result->datas[i] = result->entitys;
 		{
-			result->functions[i] = tem_ptr;
-			tem_ptr += element_count;
+			void* ptr = buffer;
+			page_size = owner->page_size() - (buffer - reinterpret_cast<std::byte*>(result));
+			size_t mask_count = (element_count + 63) / 64;
+			size_t word_count = mask_count * (layout_count + 1) + layout_count * 3;
+			auto result_r = std::align(alignof(uint64_t), sizeof(uint64_t) * word_count, ptr, page_size);
+			assert(result_r != nullptr);
+			uint64_t* words = reinterpret_cast<uint64_t*>(ptr);
+			for (size_t i = 0; i < word_count; ++i)
+				words[i] = 0;
+			result->mask_count = mask_count;
+			result->hole_mask = words;
+			result->changed_versions = result->hole_mask + mask_count;
+			result->added_versions = result->changed_versions + layout_count;
+			result->disable_count = result->added_versions + layout_count;
+			result->disable_mask = result->disable_count + layout_count;
 		}
 		return result;
 	}
@@ -130,38 +166,55 @@ namespace Noodles::Implement
 	void release_storage_block(StorageBlock* input, size_t index)
 	{
 		for (size_t i = 0; i < input->m_owner->layouts().count; ++i)
-			input->functions[i][index].destructor(
-				reinterpret_cast<std::byte*>(input->datas[i]) + input->m_owner->layouts()[i].size * index
+		{
+			input->functions[i].destruct(
+				reinterpret_cast<std::byte*>(input->datas[i]) + input->m_owner->layouts()[i].storage_size() * index
 			);
+			set_disabled(input, i, index, false);
+		}
 		auto& entity = input->entitys[index];
-		if (entity != nullptr)
+		if (entity != EntityId::invalid_index)
 		{
-			entity->set(nullptr, nullptr, 0);
-			entity->sub_ref();
-			entity = nullptr;
+			input->m_owner->entity_table()->locate(entity, nullptr, 0);
+			entity = EntityId::invalid_index;
 		}
 	}
 
-	void free_storage_block(StorageBlock* input) noexcept
+	// destruct the elements and unlink their entities, nothing for trivial columns
+	void clear_storage_block(StorageBlock* input) noexcept
 	{
 		for (size_t l = 0; l < input->m_owner->layouts().count; ++l)
 		{
-			auto function = input->functions[l];
+			auto& function = input->functions[l];
+			if (function.destructor == nullptr)
+				continue;
 			auto data = input->datas[l];
-			auto layout_size = input->m_owner->layouts()[l].size;
+			auto layout_size = input->m_owner->layouts()[l].storage_size();
 			for (size_t i = 0; i < input->available_count; ++i)
-				function[i].destructor(reinterpret_cast<std::byte*>(data) + layout_size * i);
+				if (input->entitys[i] != EntityId::invalid_index)
+					function.destructor(reinterpret_cast<std::byte*>(data) + layout_size * i);
 		}
+		EntityTable* table = input->m_owner->entity_table();
 		for (size_t i = 0; i < input->available_count; ++i)
 		{
 			auto& entity = input->entitys[i];
-			if (entity != nullptr)
+			if (entity != EntityId::invalid_index)
 			{
-				entity->set(nullptr, nullptr, 0);
-				entity->sub_ref();
-				entity = nullptr;
+				table->locate(entity, nullptr, 0);
+				entity = EntityId::invalid_index;
 			}
 		}
+		size_t layout_count = input->m_owner->layouts().count;
+		for (size_t i = 0; i < layout_count; ++i)
+			input->disable_count[i] = 0;
+		for (size_t i = 0; i < input->mask_count * layout_count; ++i)
+			input->disable_mask[i] = 0;
+		input->available_count = 0;
+	}
+
+	void free_storage_block(StorageBlock* input) noexcept
+	{
+		clear_storage_block(input);
 		MemoryPageAllocator::release(reinterpret_cast<std::byte*>(input));
 	}
 
@@ -195,44 +248,57 @@ namespace Noodles::Implement
 		}
 	}
 
+	void TypeGroup::remove_page_from_partial_list(StorageBlock* block) noexcept
+	{
+		auto front = block->partial_front;
+		auto next = block->partial_next;
+		if (front != nullptr)
+			front->partial_next = next;
+		else {
+			assert(m_partial_block == block);
+			m_partial_block = next;
+		}
+		if (next != nullptr)
+			next->partial_front = front;
+		block->partial_front = nullptr;
+		block->partial_next = nullptr;
+	}
+
+	void TypeGroup::insert_page_to_partial_list(StorageBlock* block) noexcept
+	{
+		block->partial_front = nullptr;
+		block->partial_next = m_partial_block;
+		if (m_partial_block != nullptr)
+			m_partial_block->partial_front = block;
+		m_partial_block = block;
+	}
+
 	std::tuple<StorageBlock*, size_t> TypeGroup::allocate_group(MemoryPageAllocator& allocator)
 	{
 		++m_available_count;
-		if (!m_deleted_page.empty())
+		if (m_partial_block != nullptr)
 		{
-			auto min = m_deleted_page.end();
-			for (auto ite = m_deleted_page.begin(); ite != m_deleted_page.end(); ++ite)
+			StorageBlock* block = m_partial_block;
+			assert(block->hole_count > 0);
+			for (size_t i = 0; i < block->mask_count; ++i)
 			{
-				if (min != m_deleted_page.end())
+				uint64_t& mask = block->hole_mask[i];
+				if (mask != 0)
 				{
-					if (min->second > ite->second)
-					{
-						assert(ite->second > 0);
-						min = ite;
-						if (ite->second == 1)
-							break;
-					}
-				}
-				else {
-					min = ite;
-					if (min->second == 1)
-						break;
+					size_t index = i * 64 + lowest_set_bit(mask);
+					mask &= mask - 1;
+					if (--block->hole_count == 0)
+						remove_page_from_partial_list(block);
+					assert(index < block->available_count && block->entitys[index] == EntityId::invalid_index);
+					return { block, index };
 				}
 			}
-			assert(min != m_deleted_page.end());
-			min->second -= 1;
-			auto [block, index] = *min;
-			if (index == 0)
-				m_deleted_page.erase(min);
-			for (size_t i = 0; block->available_count; ++i)
-				if (block->entitys[i] == nullptr)
-					return {block, i};
 			assert(false);
 			return {nullptr, 0};
 		}
 		else {
-			if (m_start_block == nullptr || m_last_block->available_count == element_count())
-				insert_page_to_list(create_storage_block(allocator, this));
+			if (m_start_block == nullptr || m_last_block->available_count == m_last_block->capacity)
+				append_storage_block(allocator, m_available_count);
 			size_t index = m_last_block->available_count;
 			++m_last_block->available_count;
 			return { m_last_block , index};
@@ -240,156 +306,221 @@ namespace Noodles::Implement
 		
 	}
 
+	std::tuple<StorageBlock*, size_t, size_t> TypeGroup::allocate_range(MemoryPageAllocator& allocator, size_t count)
+	{
+		assert(count > 0);
+		if (m_start_block == nullptr || m_last_block->available_count == m_last_block->capacity)
+			append_storage_block(allocator, m_available_count + count);
+		StorageBlock* block = m_last_block;
+		size_t index = block->available_count;
+		size_t result = std::min(count, block->capacity - index);
+		block->available_count += result;
+		m_available_count += result;
+		return { block, index, result };
+	}
+
+	void TypeGroup::append_storage_block(MemoryPageAllocator& allocator, size_t expected_count)
+	{
+		StorageBlock* block = m_reserved_block;
+		if (block != nullptr)
+		{
+			m_reserved_block = block->next;
+			block->next = nullptr;
+			--m_reserved_block_count;
+		}
+		else {
+			grow_page_size(expected_count);
+			block = new_storage_block(allocator);
+		}
+		insert_page_to_list(block);
+		++m_block_count;
+	}
+
 	void TypeGroup::inside_move(StorageBlock* source, size_t sindex, StorageBlock* target, size_t tindex)
 	{
-		assert(target->entitys[tindex] != nullptr);
-		assert(source->entitys[sindex] == nullptr);
+		assert(target->entitys[tindex] != EntityId::invalid_index);
+		assert(source->entitys[sindex] == EntityId::invalid_index);
 		for (size_t i = 0; i < m_type_layouts.count; ++i)
 		{
-			auto& s_function = source->functions[i];
-			auto& e_function= target->functions[i];
-			size_t component_size = m_type_layouts[i].size;
-			auto& e_fun = e_function[tindex];
-			auto& s_fun = s_function[sindex];
-			s_fun = e_fun;
-			s_fun.mover(
+			size_t component_size = m_type_layouts[i].storage_size();
+			m_functions[i].move(
 				reinterpret_cast<std::byte*>(source->datas[i]) + component_size * sindex,
-				reinterpret_cast<std::byte*>(target->datas[i]) + component_size * tindex
+				reinterpret_cast<std::byte*>(target->datas[i]) + component_size * tindex,
+				component_size
 			);
+			// the moved element keeps its change visible in the new block
+			source->changed_versions[i] = std::max(source->changed_versions[i], target->changed_versions[i]);
+			source->added_versions[i] = std::max(source->added_versions[i], target->added_versions[i]);
+			set_disabled(source, i, sindex, is_disabled(target, i, tindex));
 		}
 		source->entitys[sindex] = target->entitys[tindex];
-		target->entitys[tindex] = nullptr;
-		source->entitys[sindex]->set(this, source, sindex);
+		target->entitys[tindex] = EntityId::invalid_index;
+		m_entity_table->locate(source->entitys[sindex], source, sindex);
 		release_storage_block(target, tindex);
 	}
 
 	void TypeGroup::release_group(StorageBlock* block, size_t index)
 	{
-		assert(index < element_count());
+		assert(index < block->capacity);
 		--m_available_count;
 		release_storage_block(block, index);
-		auto ite = m_deleted_page.insert({ block, 0 }).first;
-		++ite->second;
-		if (block->available_count == ite->second)
+		assert((block->hole_mask[index / 64] & (uint64_t(1) << (index % 64))) == 0);
+		block->hole_mask[index / 64] |= uint64_t(1) << (index % 64);
+		if (block->hole_count++ == 0)
+			insert_page_to_partial_list(block);
+		if (block->available_count == block->hole_count)
 		{
+			remove_page_from_partial_list(block);
 			remove_page_from_list(block);
 			block->available_count = 0;
-			free_storage_block(block);
-			m_deleted_page.erase(ite);
+			recycle_storage_block(block);
 		}
 	}
 
-	size_t backward_search(Implement::EntityInterface** start, size_t start_index, size_t end_index)
+	void TypeGroup::release_all() noexcept
 	{
-		while (start_index < end_index)
+		StorageBlock* block = m_start_block;
+		m_start_block = nullptr;
+		m_last_block = nullptr;
+		m_partial_block = nullptr;
+		m_available_count = 0;
+		while (block != nullptr)
 		{
-			if (start[start_index] == nullptr)
-				return start_index;
-			else
-				++start_index;
+			StorageBlock* next = block->next;
+			clear_storage_block(block);
+			block->front = nullptr;
+			block->next = nullptr;
+			block->partial_front = nullptr;
+			block->partial_next = nullptr;
+			recycle_storage_block(block);
+			block = next;
 		}
-		return start_index;
 	}
 
-	size_t forward_search(Implement::EntityInterface** start, size_t start_index, size_t end_index)
+	void TypeGroup::recycle_storage_block(StorageBlock* block) noexcept
 	{
-		while (start_index > end_index)
+		assert(block->available_count == 0);
+		assert(m_block_count > 0);
+		--m_block_count;
+		for (size_t i = 0; i < block->mask_count; ++i)
+			block->hole_mask[i] = 0;
+		block->hole_count = 0;
+		// a reused block starts as a new one, Changed and Added only see what is written after
+		for (size_t i = 0; i < layouts().count; ++i)
 		{
-			if (start[start_index - 1] != nullptr)
-				return start_index;
-			else
-				--start_index;
+			block->changed_versions[i] = 0;
+			block->added_versions[i] = 0;
 		}
-		return start_index;
+		if (m_capacity - block->capacity < m_reserved_capacity)
+		{
+			for (size_t i = 0; i < block->capacity; ++i)
+				block->entitys[i] = EntityId::invalid_index;
+			block->front = nullptr;
+			block->next = m_reserved_block;
+			m_reserved_block = block;
+			++m_reserved_block_count;
+		}
+		else
+			delete_storage_block(block);
 	}
 
-	void TypeGroup::update()
+	void TypeGroup::reserve(MemoryPageAllocator& allocator, size_t count)
 	{
-		if (!m_deleted_page.empty())
+		m_reserved_capacity = count;
+		grow_page_size(count);
+		while (capacity() < count)
+		{
+			StorageBlock* block = new_storage_block(allocator);
+			block->next = m_reserved_block;
+			m_reserved_block = block;
+			++m_reserved_block_count;
+		}
+	}
+
+	void TypeGroup::shrink_to_fit() noexcept
+	{
+		m_reserved_capacity = 0;
+		while (m_reserved_block != nullptr)
+		{
+			auto tem = m_reserved_block;
+			m_reserved_block = m_reserved_block->next;
+			delete_storage_block(tem);
+		}
+		m_reserved_block_count = 0;
+	}
+
+	StorageBlock* TypeGroup::new_storage_block(MemoryPageAllocator& allocator)
+	{
+		StorageBlock* block = create_storage_block(allocator, this);
+		m_capacity += block->capacity;
+		return block;
+	}
+
+	void TypeGroup::delete_storage_block(StorageBlock* block) noexcept
+	{
+		assert(m_capacity >= block->capacity);
+		m_capacity -= block->capacity;
+		free_storage_block(block);
+	}
+
+	bool TypeGroup::update(size_t& move_budget, std::chrono::steady_clock::time_point deadline)
+	{
+		size_t moved = 0;
+		while (m_partial_block != nullptr)
 		{
 			assert(m_last_block != nullptr);
-			std::deque<std::pair<StorageBlock*, size_t>> all_block;
-			size_t last_page_deleted = 0;
-			for (auto& ite : m_deleted_page)
+			StorageBlock* last = m_last_block;
+			while (last->available_count > 0 && last->entitys[last->available_count - 1] == EntityId::invalid_index)
 			{
-				if (ite.first != m_last_block)
-				{
-					remove_page_from_list(ite.first);
-					all_block.push_back(ite);
-				}
-				else {
-					assert(last_page_deleted == 0);
-					last_page_deleted = ite.second;
-				}
+				size_t index = last->available_count - 1;
+				assert(last->hole_count > 0);
+				last->hole_mask[index / 64] &= ~(uint64_t(1) << (index % 64));
+				--last->hole_count;
+				--last->available_count;
 			}
-			m_deleted_page.clear();
-			last_page_deleted += element_count() - m_last_block->available_count;
-			m_last_block->available_count = element_count();
-			
-			if (last_page_deleted != 0) {
-				all_block.push_back({ m_last_block , last_page_deleted });
-				remove_page_from_list(m_last_block);
+			if (last->hole_count == 0 && (last->partial_front != nullptr || m_partial_block == last))
+				remove_page_from_partial_list(last);
+			if (last->available_count == 0)
+			{
+				remove_page_from_list(last);
+				recycle_storage_block(last);
+				continue;
 			}
-			std::sort(all_block.begin(), all_block.end(), [](const std::tuple<StorageBlock*, size_t>& in, const std::tuple<StorageBlock*, size_t>& in2) -> bool {
-				return std::get<1>(in) < std::get<1>(in2);
-			});
-			assert(!all_block.empty());
-			size_t start_i = 0, end_i = element_count();
-			while (all_block.size() > 1)
+			if (m_partial_block == nullptr)
+				break;
+			if (move_budget == 0 || (moved % 32 == 31 && std::chrono::steady_clock::now() >= deadline))
+				return false;
+
+			// fill the first hole with the last element of the group
+			StorageBlock* block = m_partial_block;
+			size_t index = 0;
+			for (size_t i = 0; i < block->mask_count; ++i)
 			{
-				auto start = all_block.begin();
-				auto end = all_block.end() - 1;
-				auto& s_entitys = start->first->entitys;
-				auto& e_entitys = end->first->entitys;
-				while (true)
+				uint64_t& mask = block->hole_mask[i];
+				if (mask != 0)
 				{
-					start_i = backward_search(s_entitys, start_i, element_count());
-					if (start_i != element_count())
-					{
-						end_i = forward_search(e_entitys, end_i, 0);
-						if (end_i != 0)
-						{
-							inside_move(start->first, start_i, end->first, end_i - 1);
-						}
-						else {
-							end_i = element_count();
-							end->first->available_count = 0;
-							free_storage_block(end->first);
-							all_block.pop_back();
-							break;
-						}
-					}
-					else {
-						start_i = 0;
-						insert_page_to_list(start->first);
-						all_block.pop_front();
-						break;
-					}
+					index = i * 64 + lowest_set_bit(mask);
+					mask &= mask - 1;
+					break;
 				}
 			}
-			auto cur = all_block.begin();
-			auto& entitys = cur->first->entitys;
-
-			while (true)
+			assert(index < block->available_count && block->entitys[index] == EntityId::invalid_index);
+			if (--block->hole_count == 0)
+				remove_page_from_partial_list(block);
+			inside_move(block, index, last, last->available_count - 1);
+			--last->available_count;
+			--move_budget;
+			++moved;
+			if (last->available_count == 0)
 			{
-				start_i = backward_search(entitys, start_i, end_i);
-				end_i = forward_search(entitys, end_i, start_i);
-				if (start_i + 1 < end_i)
-					inside_move(cur->first, start_i, cur->first, end_i - 1);
-				else
-					break;
+				remove_page_from_list(last);
+				recycle_storage_block(last);
 			}
-
-			cur->first->available_count = start_i;
-			if (cur->first->available_count != 0)
-				insert_page_to_list(cur->first);
-			else
-				free_storage_block(cur->first);
-			all_block.clear();
 		}
+		return true;
 	}
 
-	TypeGroup* TypeGroup::create(TypeLayoutArray array)
+	TypeGroup* TypeGroup::create(TypeLayoutArray array, const StorageLayoutPolicy& policy, EntityTable* table)
 	{
 		size_t total_size = sizeof(TypeGroup) + array.count * sizeof(TypeInfo);
 		std::byte* data = new std::byte[total_size];
@@ -397,7 +528,7 @@ namespace Noodles::Implement
 		for (size_t i = 0; i < array.count; ++i)
 			new (layout + i) TypeInfo{array.layouts[i]};
 		TypeLayoutArray layouts{ layout , array.count};
-		TypeGroup* result = new (data) TypeGroup{layouts};
+		TypeGroup* result = new (data) TypeGroup{layouts, policy, table};
 		return result;
 	}
 
@@ -411,34 +542,106 @@ namespace Noodles::Implement
 		delete[] reinterpret_cast<std::byte*>(input);
 	}
 
+	const TypeGroupEdge* TypeGroup::find_edge(const TypeInfo& type, bool add) const noexcept
+	{
+		auto& edges = add ? m_add_edges : m_remove_edges;
+		auto ite = edges.find(type);
+		return ite != edges.end() ? &ite->second : nullptr;
+	}
+
+	const TypeGroupEdge& TypeGroup::insert_edge(const TypeInfo& type, bool add, TypeGroup* target)
+	{
+		assert(target != nullptr);
+		TypeGroupEdge edge{ target, {} };
+		edge.columns.reserve(target->layouts().count);
+		for (size_t i = 0; i < target->layouts().count; ++i)
+			edge.columns.push_back(m_type_layouts.locate(target->layouts()[i]));
+		auto& edges = add ? m_add_edges : m_remove_edges;
+		return edges.insert_or_assign(type, std::move(edge)).first->second;
+	}
+
+	void TypeGroup::set_signature(const size_t* ids) noexcept
+	{
+		m_signature.clear();
+		m_id_column.clear();
+		for (size_t i = 0; i < m_type_layouts.count; ++i)
+		{
+			size_t id = ids[i];
+			if (m_signature.size() <= id / 64)
+				m_signature.resize(id / 64 + 1, 0);
+			m_signature[id / 64] |= uint64_t(1) << (id % 64);
+			if (m_id_column.size() <= id)
+				m_id_column.resize(id + 1, m_type_layouts.count);
+			m_id_column[id] = i;
+		}
+		m_hash = m_type_layouts.hash();
+	}
+
+	bool TypeGroup::match(const uint64_t* signature, size_t word_count) const noexcept
+	{
+		if (word_count > m_signature.size())
+		{
+			for (size_t i = m_signature.size(); i < word_count; ++i)
+				if (signature[i] != 0)
+					return false;
+			word_count = m_signature.size();
+		}
+		for (size_t i = 0; i < word_count; ++i)
+			if ((m_signature[i] & signature[i]) != signature[i])
+				return false;
+		return true;
+	}
+
 	TypeGroup::~TypeGroup()
 	{
 		while (m_start_block != nullptr)
 		{
 			auto tem = m_start_block;
 			m_start_block = m_start_block->next;
-			free_storage_block(tem);
+			delete_storage_block(tem);
 		}
+		shrink_to_fit();
 	}
 
-	TypeGroup::TypeGroup(TypeLayoutArray input)
-		: m_type_layouts(input)
+	void TypeGroup::set_page_size(size_t page_size) noexcept
+	{
+		size_t min_size = m_fixed_size + m_element_size * std::max(m_policy.min_element_count, size_t(1));
+		std::tie(m_page_size, std::ignore) = MemoryPageAllocator::pre_calculte_size(std::max(page_size, min_size));
+		m_element_count = (m_page_size - m_fixed_size) / m_element_size;
+		while (m_element_count * m_element_size + (m_element_count + 63) / 64 * sizeof(uint64_t) * (m_type_layouts.count + 1) > m_page_size - m_fixed_size)
+			--m_element_count;
+		if (m_policy.capacity_step > 1 && m_element_count >= m_policy.capacity_step)
+			m_element_count -= m_element_count % m_policy.capacity_step;
+		assert(m_element_count > 0);
+	}
+
+	void TypeGroup::grow_page_size(size_t count) noexcept
+	{
+		size_t max_size = m_policy.max_page_size - std::min(m_policy.max_page_size, MemoryPageAllocator::reserved_size());
+		while (m_page_size < max_size && count > m_element_count * m_policy.grow_block_count)
+		{
+			size_t old_size = m_page_size;
+			set_page_size(std::min((m_page_size + MemoryPageAllocator::reserved_size()) * 2 - MemoryPageAllocator::reserved_size(), max_size));
+			if (m_page_size <= old_size)
+				break;
+		}
+	}
+
+	TypeGroup::TypeGroup(TypeLayoutArray input, const StorageLayoutPolicy& policy, EntityTable* table)
+		: m_type_layouts(input), m_policy(policy), m_functions(input.count), m_entity_table(table)
 	{
 		size_t all_size = 0;
 		size_t all_align = 0;
 		for (size_t i = 0; i < m_type_layouts.count; ++i)
 		{
+			if (m_type_layouts.layouts[i].tag)
+				continue;
 			all_size += m_type_layouts.layouts[i].size;
-			auto align_size = (m_type_layouts.layouts[i].align > alignof(nullptr_t)) ? m_type_layouts.layouts[i].align : alignof(nullptr_t);
-			all_align += align_size;
+			all_align += std::max({ m_type_layouts.layouts[i].align, m_policy.column_align, alignof(nullptr_t) });
 		}
-		size_t element_size = all_size + sizeof(EntityInterface*) + sizeof(StorageBlockFunctionPair) * m_type_layouts.count;
-		size_t fixed_size = sizeof(StorageBlock) + (sizeof(StorageBlockFunctionPair*) + sizeof(void*)) * m_type_layouts.count + all_align + alignof(nullptr_t);
-		m_page_size = fixed_size + element_size * min_page_comp_count;
-		size_t bound_size = 1024 * 8 - MemoryPageAllocator::reserved_size();
-		m_page_size = (m_page_size > bound_size) ? m_page_size : bound_size;
-		std::tie(m_page_size, std::ignore) = MemoryPageAllocator::pre_calculte_size(m_page_size);
-		m_element_count = (m_page_size - fixed_size) / element_size;
+		m_element_size = all_size + sizeof(uint32_t);
+		m_fixed_size = sizeof(StorageBlock) + (sizeof(void*) + sizeof(uint64_t) * 3) * m_type_layouts.count + all_align + alignof(nullptr_t) + alignof(uint64_t);
+		set_page_size(m_policy.min_page_size - std::min(m_policy.min_page_size, MemoryPageAllocator::reserved_size()));
 	}
 
 	ComponentPool::InitBlock::~InitBlock()
@@ -451,225 +654,987 @@ namespace Noodles::Implement
 
 	ComponentPool::InitHistory::~InitHistory()
 	{
-		if (ope == EntityOperator::Construct)
+		if (ope == EntityOperator::Construct && data != nullptr)
+			functions.destruct(data);
+	}
+
+	void ComponentPool::CommandRecord::clear() noexcept
+	{
+		// histories destruct the components staged in the blocks
+		histories.clear();
+		batches.clear();
+		blocks.clear();
+	}
+
+	ComponentPool::LocalCommandBuffers::~LocalCommandBuffers()
+	{
+		for (auto& ite : buffers)
+			ite->retired.store(true, std::memory_order_release);
+	}
+
+	auto ComponentPool::local_buffer() -> CommandBuffer&
+	{
+		thread_local LocalCommandBuffers local;
+		thread_local CommandBuffer* buffer = nullptr;
+		if (buffer == nullptr || buffer->serial != m_serial)
 		{
-			assert(data != nullptr);
-			functions.destructor(data);
+			// buffers of destructed pools are never drained again
+			local.buffers.erase(std::remove_if(local.buffers.begin(), local.buffers.end(), [](const std::shared_ptr<CommandBuffer>& ite) {
+				return ite->closed.load(std::memory_order_acquire);
+			}), local.buffers.end());
+			auto find_result = std::find_if(local.buffers.begin(), local.buffers.end(), [&](const std::shared_ptr<CommandBuffer>& ite) { return ite->serial == m_serial; });
+			if (find_result == local.buffers.end())
+			{
+				auto new_buffer = std::make_shared<CommandBuffer>();
+				new_buffer->serial = m_serial;
+				{
+					std::lock_guard lg(m_buffer_lock);
+					new_buffer->index = m_buffer_count++;
+					m_buffers.push_back(new_buffer);
+				}
+				local.buffers.push_back(std::move(new_buffer));
+				find_result = local.buffers.end() - 1;
+			}
+			buffer = find_result->get();
 		}
+		return *buffer;
 	}
 
-	void ComponentPool::construct_component(
-		const TypeInfo& layout, void(*constructor)(void*, void*), void* data,
-		EntityInterface* entity, void(*deconstructor)(void*) noexcept, void(*mover)(void*, void*) noexcept
-	)
+	void ComponentPool::drain_buffers(CommandRecord& output)
+	{
+		std::lock_guard lg(m_buffer_lock);
+		for (auto& ite : m_buffers)
+		{
+			// read before the flip, a retired thread has finished all its appends
+			bool retired = ite->retired.load(std::memory_order_acquire);
+			size_t side = ite->side.load(std::memory_order_relaxed);
+			ite->side.store(side ^ 1);
+			while (ite->writing.load() != 0)
+				std::this_thread::yield();
+			auto& record = ite->records[side];
+			std::move(record.blocks.begin(), record.blocks.end(), std::back_inserter(output.blocks));
+			std::move(record.histories.begin(), record.histories.end(), std::back_inserter(output.histories));
+			std::move(record.batches.begin(), record.batches.end(), std::back_inserter(output.batches));
+			record.clear();
+			if (retired)
+				ite.reset();
+		}
+		m_buffers.erase(std::remove(m_buffers.begin(), m_buffers.end(), nullptr), m_buffers.end());
+	}
+
+	void* ComponentPool::stage_component(CommandRecord& record, const TypeInfo& layout)
 	{
-		std::lock_guard lg(m_init_lock);
 		size_t aligned_size = layout.align > sizeof(nullptr_t) ? layout.align - sizeof(nullptr_t) : 0;
-		if (m_init_block.empty() || m_init_block.rbegin()->last_available_count < aligned_size + layout.size)
+		if (record.blocks.empty() || record.blocks.rbegin()->last_available_count < aligned_size + layout.size)
 		{
 			size_t allocate_size = 1024 * 16 - MemoryPageAllocator::reserved_size();
-			assert(allocate_size > aligned_size + layout.size);
-			auto [buffer, size] = m_allocator.allocate(allocate_size);
-			m_init_block.emplace_back(buffer, buffer, size);
+			allocate_size = (allocate_size > aligned_size + layout.size) ? allocate_size : aligned_size + layout.size;
+			auto [page, size] = m_allocator.allocate(allocate_size);
+			record.blocks.emplace_back(page, page, size);
 		}
-
-		assert(!m_init_block.empty());
-		auto& [head, last, size] = *m_init_block.rbegin();
+		auto& [head, last, size] = *record.blocks.rbegin();
 		auto result = std::align(layout.align, layout.size, last, size);
 		assert(result != nullptr);
-		assert(entity != nullptr);
-		constructor(last, data);
-		EntityInterfacePtr ptr(entity);
-		m_init_history[ptr].emplace_back(EntityOperator::Construct, layout, StorageBlockFunctionPair{deconstructor, mover}, last );
 		last = reinterpret_cast<std::byte*>(last) + layout.size;
 		size -= layout.size;
+		return result;
 	}
 
-	void ComponentPool::deconstruct_component(EntityInterface* entity, const TypeInfo& layout) noexcept
+	void ComponentPool::construct_component(
+		const TypeInfo& layout, void(*constructor)(void*, void*), void* data,
+		EntityId entity, void(*deconstructor)(void*) noexcept, void(*mover)(void*, void*) noexcept
+	)
 	{
-		assert(entity != nullptr);
+		assert(entity.index != EntityId::invalid_index);
+		RecordScope scope(local_buffer());
+		if (layout.tag)
+		{
+			scope.record.histories.emplace_back(entity, scope.buffer(), scope.next_sequence(), EntityOperator::Construct, layout, StorageBlockFunctionPair{}, nullptr);
+			return;
+		}
+		void* target = stage_component(scope.record, layout);
+		constructor(target, data);
+		scope.record.histories.emplace_back(entity, scope.buffer(), scope.next_sequence(), EntityOperator::Construct, layout, StorageBlockFunctionPair{deconstructor, mover}, target);
+	}
+
+	ComponentPool::InitBatch::~InitBatch()
+	{
+		for (size_t i = 0; i < types.size(); ++i)
+		{
+			if (functions[i].destructor == nullptr)
+				continue;
+			for (size_t k = 0; k < count; ++k)
+				functions[i].destructor(reinterpret_cast<std::byte*>(columns[i]) + types[i].storage_size() * k);
+		}
+		if (buffer != nullptr)
+			MemoryPageAllocator::release(buffer);
+	}
+
+	void ComponentPool::construct_components(
+		const TypeInfo* layouts, const StorageBlockFunctionPair* functions, size_t type_count,
+		const EntityId* entities, size_t count, void(*constructor)(void** columns, size_t count, void* parameter), void* parameter
+	)
+	{
+		assert(layouts != nullptr && functions != nullptr && type_count != 0);
+		if (count == 0)
+			return;
+		InitBatch batch;
+		batch.types.assign(layouts, layouts + type_count);
+		batch.functions.assign(functions, functions + type_count);
+		batch.entitys.assign(entities, entities + count);
+		batch.columns.resize(type_count, nullptr);
+		size_t total_size = 0;
+		for (size_t i = 0; i < type_count; ++i)
+			if (!layouts[i].tag)
+				total_size += layouts[i].align + layouts[i].size * count;
+		if (total_size != 0)
+		{
+			auto [buffer, size] = m_allocator.allocate(total_size);
+			batch.buffer = buffer;
+			void* ptr = buffer;
+			for (size_t i = 0; i < type_count; ++i)
+			{
+				if (layouts[i].tag)
+					continue;
+				auto result = std::align(layouts[i].align, layouts[i].size * count, ptr, size);
+				assert(result != nullptr);
+				batch.columns[i] = ptr;
+				ptr = reinterpret_cast<std::byte*>(ptr) + layouts[i].size * count;
+				size -= layouts[i].size * count;
+			}
+		}
+		constructor(batch.columns.data(), count, parameter);
+		batch.count = count;
+		RecordScope scope(local_buffer());
+		batch.record_buffer = scope.buffer();
+		batch.sequence = scope.next_sequence();
+		scope.record.batches.push_back(std::move(batch));
+	}
+
+	void ComponentPool::deconstruct_component(EntityId entity, const TypeInfo& layout) noexcept
+	{
+		assert(entity.index != EntityId::invalid_index);
+		RecordScope scope(local_buffer());
+		scope.record.histories.emplace_back(entity, scope.buffer(), scope.next_sequence(), EntityOperator::Destruct, layout, StorageBlockFunctionPair{nullptr, nullptr}, nullptr);
+	}
+
+	void ComponentPool::reserve_type_group(const TypeInfo* layouts, size_t count, size_t reserve_count)
+	{
+		assert(layouts != nullptr && count != 0);
+		std::vector<TypeInfo> types(layouts, layouts + count);
+		std::sort(types.begin(), types.end());
+		types.erase(std::unique(types.begin(), types.end()), types.end());
+		std::lock_guard lg(m_init_lock);
+		m_reserve_history.push_back({ std::move(types), reserve_count, false });
+	}
+
+	void ComponentPool::shrink_type_group(const TypeInfo* layouts, size_t count)
+	{
+		assert(layouts != nullptr && count != 0);
+		std::vector<TypeInfo> types(layouts, layouts + count);
+		std::sort(types.begin(), types.end());
+		types.erase(std::unique(types.begin(), types.end()), types.end());
 		std::lock_guard lg(m_init_lock);
-		EntityInterfacePtr ptr(entity);
-		m_init_history[ptr].emplace_back(EntityOperator::Destruct, layout, StorageBlockFunctionPair{nullptr, nullptr}, nullptr);
+		m_reserve_history.push_back({ std::move(types), 0, true });
 	}
 
-	ComponentPool::ComponentPool(MemoryPageAllocator& allocator) noexcept : m_allocator(allocator){}
+	void ComponentPool::destory_type_groups(const TypeInfo* layouts, size_t count)
+	{
+		assert(layouts != nullptr && count != 0);
+		std::vector<TypeInfo> types(layouts, layouts + count);
+		std::sort(types.begin(), types.end());
+		types.erase(std::unique(types.begin(), types.end()), types.end());
+		std::lock_guard lg(m_init_lock);
+		m_destory_history.push_back(std::move(types));
+	}
+
+	ComponentPool::ComponentPool(MemoryPageAllocator& allocator) noexcept
+		: m_allocator(allocator), m_serial(pool_serial.fetch_add(1, std::memory_order_relaxed) + 1), m_entity_pool(static_cast<uint32_t>(m_serial), m_sparse_set) {}
 
 	void ComponentPool::clean_all()
 	{
 		std::lock_guard lg(m_init_lock);
-		m_init_history.clear();
-		m_init_block.clear();
+		{
+			CommandRecord record;
+			drain_buffers(record);
+		}
+		m_reserve_history.clear();
+		m_destory_history.clear();
 		std::unique_lock ul(m_type_group_mutex);
-		for (auto& ite : m_data)
-			TypeGroup::free(ite.second);
+		for (auto& ite : m_sparse_set)
+			if (ite)
+				free_sparse_set(*ite);
+		m_sparse_set.clear();
+		for (auto ite : m_type_group)
+			TypeGroup::free(ite);
 		m_data.clear();
+		m_type_group.clear();
+		m_root_group.clear();
+		m_entity_pool.release_all();
 	}
 
-	void ComponentPool::handle_entity_imp(EntityInterface* entity, EntityOperator ope) noexcept
+	void ComponentPool::allocate_entity(EntityId* output, size_t count)
 	{
-		assert(entity != nullptr);
-		std::lock_guard lg(m_init_lock);
-		m_init_history[entity].emplace_back(ope, TypeInfo::create<int>(), StorageBlockFunctionPair{ nullptr, nullptr }, nullptr);
+		assert(output != nullptr || count == 0);
+		m_entity_pool.allocate(output, count);
+	}
+
+	void ComponentPool::handle_entity_imp(EntityId entity, EntityOperator ope) noexcept
+	{
+		assert(entity.index != EntityId::invalid_index);
+		RecordScope scope(local_buffer());
+		scope.record.histories.emplace_back(entity, scope.buffer(), scope.next_sequence(), ope, TypeInfo::create<int>(), StorageBlockFunctionPair{ nullptr, nullptr }, nullptr);
 	}
 
 
-	bool ComponentPool::update()
+	void move_storage_element(StorageBlock* target, size_t tcolumn, size_t tindex, StorageBlock* source, size_t scolumn, size_t sindex, size_t component_size) noexcept
 	{
-		std::lock_guard lg(m_init_lock);
-		std::unique_lock ul(m_type_group_mutex);
-		bool new_type_group = false;
-		for (auto& ite : m_init_history)
-		{
-			Implement::TypeGroup* old_type_group;
-			Implement::StorageBlock* old_storage_block;
-			size_t old_element_index;
-			ite.first->read(old_type_group, old_storage_block, old_element_index);
-			std::map<TypeInfo, std::variant<size_t, InitHistory*>> old_type_template;
-			if (old_type_group != nullptr)
-			{
-				assert(old_storage_block != nullptr);
-				assert(old_element_index < old_type_group->element_count());
-				for (size_t i = 0; i < old_type_group->layouts().count; ++i)
-					old_type_template.insert({ old_type_group->layouts()[i], i });
-			}
-			for (auto& ite2 : ite.second)
+		auto& functions = target->functions[tcolumn];
+		functions = source->functions[scolumn];
+		functions.move(
+			reinterpret_cast<std::byte*>(target->datas[tcolumn]) + component_size * tindex,
+			reinterpret_cast<std::byte*>(source->datas[scolumn]) + component_size * sindex,
+			component_size
+		);
+		target->changed_versions[tcolumn] = std::max(target->changed_versions[tcolumn], source->changed_versions[scolumn]);
+		target->added_versions[tcolumn] = std::max(target->added_versions[tcolumn], source->added_versions[scolumn]);
+		set_disabled(target, tcolumn, tindex, is_disabled(source, scolumn, sindex));
+	}
+
+	void construct_storage_element(StorageBlock* target, size_t column, size_t index, StorageBlockFunctionPair functions, void* data, size_t component_size, uint64_t version) noexcept
+	{
+		target->functions[column] = functions;
+		functions.move(reinterpret_cast<std::byte*>(target->datas[column]) + component_size * index, data, component_size);
+		target->changed_versions[column] = version;
+		target->added_versions[column] = version;
+		set_disabled(target, column, index, false);
+	}
+
+	// link the entity to the new slot and release the old one
+	void transfer_entity(uint32_t entity, TypeGroup* new_group, StorageBlock* new_block, size_t new_index, TypeGroup* old_group, StorageBlock* old_block, size_t old_index) noexcept
+	{
+		new_block->entitys[new_index] = entity;
+		new_group->entity_table()->locate(entity, new_block, new_index);
+		if (old_group != nullptr)
+		{
+			old_block->entitys[old_index] = EntityId::invalid_index;
+			old_group->release_group(old_block, old_index);
+		}
+	}
+
+	TypeGroup* ComponentPool::find_type_group(TypeLayoutArray layouts) const noexcept
+	{
+		auto [start, end] = m_data.equal_range(layouts.hash());
+		for (; start != end; ++start)
+		{
+			if (start->second->layouts() == layouts)
+				return start->second;
+		}
+		return nullptr;
+	}
+
+	TypeGroup* ComponentPool::find_type_group(TypeLayoutArray layouts, bool& new_type_group)
+	{
+		TypeGroup* result = find_type_group(layouts);
+		if (result == nullptr)
+		{
+			result = TypeGroup::create(layouts, m_layout_policy, &m_entity_pool);
+			std::vector<size_t> ids;
+			ids.reserve(layouts.count);
+			for (size_t i = 0; i < layouts.count; ++i)
+				ids.push_back(m_entity_pool.component_id(layouts[i]));
+			result->set_signature(ids.data());
+			m_data.insert({ result->hash(), result });
+			m_type_group.push_back(result);
+			new_type_group = true;
+		}
+		return result;
+	}
+
+	const TypeGroupEdge& ComponentPool::find_type_group_edge(TypeGroup* source, const TypeInfo& type, bool add, bool& new_type_group)
+	{
+		assert(source != nullptr);
+		const TypeGroupEdge* edge = source->find_edge(type, add);
+		if (edge != nullptr)
+			return *edge;
+		auto layouts = source->layouts();
+		std::vector<TypeInfo> new_layouts;
+		new_layouts.reserve(layouts.count + 1);
+		for (size_t i = 0; i < layouts.count; ++i)
+		{
+			if (add && type < layouts[i] && (new_layouts.size() == i))
+				new_layouts.push_back(type);
+			if (add || layouts[i] != type)
+				new_layouts.push_back(layouts[i]);
+		}
+		if (add && new_layouts.size() == layouts.count)
+			new_layouts.push_back(type);
+		TypeGroup* target = find_type_group({ new_layouts.data(), new_layouts.size() }, new_type_group);
+		return source->insert_edge(type, add, target);
+	}
+
+	void ComponentPool::plan_history(HistoryPlan& plan) const
+	{
+		const EntitySlot& slot = m_entity_pool.slot(plan.entity);
+		plan.block = slot.block;
+		plan.index = slot.index;
+		plan.source = (slot.block != nullptr) ? slot.block->m_owner : nullptr;
+		if (plan.end - plan.begin == 1)
+		{
+			InitHistory& history = *plan.begin;
+			if (history.ope == EntityOperator::Construct)
 			{
-				bool need_destory = false;
-				switch (ite2.ope)
+				if (plan.source == nullptr)
 				{
-				case EntityOperator::Construct:
-					old_type_template[ite2.type] = &ite2;
-					break;
-				case EntityOperator::Destruct:
-					old_type_template.erase(ite2.type);
-					break;
-				case EntityOperator::Destory:
-					need_destory = true;
-				case EntityOperator::DeleteAll:
-					old_type_template.clear();
-					break;
+					size_t id = m_entity_pool.find_component_id(history.type);
+					plan.target = (id < m_root_group.size()) ? m_root_group[id] : nullptr;
+					plan.ope = PlanOperator::Root;
+					return;
 				}
-				if (need_destory)
-					break;
-			}
-			if (!old_type_template.empty())
-			{
-				std::vector<TypeInfo> new_type_template;
-				std::vector<std::variant<size_t, InitHistory*>> new_type_state_template;
-				new_type_state_template.clear();
-				for (auto& ite2 : old_type_template)
+				// replacing a component keeps the entity in place
+				if (!plan.source->layouts().hold(history.type))
 				{
-					new_type_template.push_back(ite2.first);
-					new_type_state_template.push_back(ite2.second);
+					plan.edge = plan.source->find_edge(history.type, true);
+					plan.ope = PlanOperator::Edge;
+					return;
 				}
-				auto find_result = m_data.find({ new_type_template.data(), new_type_template.size() });
-				if (find_result == m_data.end())
-				{
-					TypeGroup* ptr = TypeGroup::create({ new_type_template.data(), new_type_template.size() });
-					auto re = m_data.insert({ ptr->layouts(), ptr });
-					assert(re.second);
-					find_result = re.first;
-					new_type_group = true;
+			}
+			else if (history.ope == EntityOperator::Destruct)
+			{
+				if (plan.source == nullptr || !plan.source->layouts().hold(history.type))
+					return;
+				if (plan.source->layouts().count == 1)
+					plan.ope = PlanOperator::Release;
+				else {
+					plan.edge = plan.source->find_edge(history.type, false);
+					plan.ope = PlanOperator::Edge;
 				}
-				if (find_result->second == old_type_group)
+				return;
+			}
+		}
+		std::map<TypeInfo, std::variant<size_t, InitHistory*>> type_template;
+		if (plan.source != nullptr)
+		{
+			assert(plan.block != nullptr);
+			assert(plan.index < plan.block->capacity);
+			for (size_t i = 0; i < plan.source->layouts().count; ++i)
+				type_template.insert({ plan.source->layouts()[i], i });
+		}
+		for (auto ite = plan.begin; ite != plan.end; ++ite)
+		{
+			bool need_destory = false;
+			switch (ite->ope)
+			{
+			case EntityOperator::Construct:
+				if (!ite->type.sparse)
+					type_template[ite->type] = ite;
+				break;
+			case EntityOperator::Destruct:
+				type_template.erase(ite->type);
+				break;
+			case EntityOperator::Destory:
+				// a destoried entity also drops all of its components
+				need_destory = true;
+				[[fallthrough]];
+			case EntityOperator::DeleteAll:
+				type_template.clear();
+				break;
+			}
+			if (need_destory)
+				break;
+		}
+		if (type_template.empty())
+		{
+			if (plan.source != nullptr)
+				plan.ope = PlanOperator::Release;
+			return;
+		}
+		plan.layouts.reserve(type_template.size());
+		plan.states.reserve(type_template.size());
+		for (auto& ite : type_template)
+		{
+			plan.layouts.push_back(ite.first);
+			plan.states.push_back(ite.second);
+		}
+		plan.target = find_type_group({ plan.layouts.data(), plan.layouts.size() });
+		plan.ope = PlanOperator::Move;
+	}
+
+	void ComponentPool::prepare_history(HistoryPlan& plan, bool& new_type_group)
+	{
+		switch (plan.ope)
+		{
+		case PlanOperator::Root:
+			if (plan.target == nullptr)
+			{
+				size_t id = m_entity_pool.component_id(plan.begin->type);
+				if (m_root_group.size() <= id)
+					m_root_group.resize(id + 1, nullptr);
+				TypeGroup*& group = m_root_group[id];
+				if (group == nullptr)
+					group = find_type_group({ &plan.begin->type, 1 }, new_type_group);
+				plan.target = group;
+			}
+			break;
+		case PlanOperator::Edge:
+			if (plan.edge == nullptr)
+				plan.edge = &find_type_group_edge(plan.source, plan.begin->type, plan.begin->ope == EntityOperator::Construct, new_type_group);
+			plan.target = plan.edge->target;
+			break;
+		case PlanOperator::Move:
+			if (plan.target == nullptr)
+				plan.target = find_type_group({ plan.layouts.data(), plan.layouts.size() }, new_type_group);
+			break;
+		default:
+			break;
+		}
+	}
+
+	void ComponentPool::apply_history(HistoryPlan& plan, uint64_t version)
+	{
+		switch (plan.ope)
+		{
+		case PlanOperator::Release:
+			plan.source->release_group(plan.block, plan.index);
+			break;
+		case PlanOperator::Root:
+		{
+			InitHistory& history = *plan.begin;
+			auto [new_block, new_index] = plan.target->allocate_group(m_allocator);
+			construct_storage_element(new_block, 0, new_index, history.functions, history.data, history.type.storage_size(), version);
+			transfer_entity(plan.entity, plan.target, new_block, new_index, nullptr, nullptr, 0);
+			break;
+		}
+		case PlanOperator::Edge:
+		{
+			InitHistory& history = *plan.begin;
+			const TypeGroupEdge& edge = *plan.edge;
+			auto [new_block, new_index] = edge.target->allocate_group(m_allocator);
+			size_t old_count = plan.source->layouts().count;
+			for (size_t i = 0; i < edge.columns.size(); ++i)
+			{
+				size_t component_size = edge.target->layouts()[i].storage_size();
+				if (edge.columns[i] == old_count)
+					construct_storage_element(new_block, i, new_index, history.functions, history.data, component_size, version);
+				else
+					move_storage_element(new_block, i, new_index, plan.block, edge.columns[i], plan.index, component_size);
+			}
+			transfer_entity(plan.entity, edge.target, new_block, new_index, plan.source, plan.block, plan.index);
+			break;
+		}
+		case PlanOperator::Move:
+			if (plan.target == plan.source)
+			{
+				std::vector<bool> state_template(plan.target->layouts().count, false);
+				for (auto ite = plan.end; ite != plan.begin;)
 				{
-					assert(old_type_group != nullptr);
-					std::vector<bool> state_template;
-					state_template.clear();
-					state_template.resize(find_result->first.count, false);
-					for (auto ite2 = ite.second.rbegin(); ite2 != ite.second.rend(); ++ite2)
+					--ite;
+					if (ite->ope == EntityOperator::Construct && !ite->type.sparse)
 					{
-						if (ite2->ope == EntityOperator::Construct)
+						size_t type_index = plan.source->layouts().locate(ite->type);
+						assert(type_index < state_template.size());
+						if (!state_template[type_index])
 						{
-							size_t type_index = old_type_group->layouts().locate(ite2->type);
-							assert(type_index < state_template.size());
-							if (!state_template[type_index])
-							{
-								auto& function = old_storage_block->functions[type_index][old_element_index];
-								auto data = reinterpret_cast<std::byte*>(old_storage_block->datas[type_index]) + new_type_template[type_index].size * old_element_index;
-								function.destructor(data);
-								ite2->functions.mover(data, ite2->data);
-								function = ite2->functions;
-								state_template[type_index] = true;
-							}
+							auto& function = plan.block->functions[type_index];
+							size_t component_size = plan.layouts[type_index].storage_size();
+							auto data = reinterpret_cast<std::byte*>(plan.block->datas[type_index]) + component_size * plan.index;
+							function.destruct(data);
+							ite->functions.move(data, ite->data, component_size);
+							function = ite->functions;
+							set_disabled(plan.block, type_index, plan.index, false);
+							plan.block->changed_versions[type_index] = version;
+							plan.block->added_versions[type_index] = version;
+							state_template[type_index] = true;
 						}
 					}
 				}
-				else {
-					auto [new_block, new_element_index] = find_result->second->allocate_group(m_allocator);
-					for (size_t i = 0; i < new_type_template.size(); ++i)
+			}
+			else {
+				auto [new_block, new_index] = plan.target->allocate_group(m_allocator);
+				for (size_t i = 0; i < plan.layouts.size(); ++i)
+				{
+					size_t component_size = plan.layouts[i].storage_size();
+					auto& var = plan.states[i];
+					if (std::holds_alternative<size_t>(var))
 					{
-						size_t component_size = new_type_template[i].size;
-						auto& functions = new_block->functions[i][new_element_index];
-						auto data = reinterpret_cast<std::byte*>(new_block->datas[i]) + component_size * new_element_index;
-						auto& var = new_type_state_template[i];
-						if (std::holds_alternative<size_t>(var))
-						{
-							size_t target_index = std::get<size_t>(var);
-							assert(old_type_group != nullptr);
-							auto source_function = old_storage_block->functions[target_index][old_element_index];
-							auto source_data = reinterpret_cast<std::byte*>(old_storage_block->datas[target_index]) + component_size * old_element_index;
-							functions = source_function;
-							functions.mover(data, source_data);
-						}
-						else if (std::holds_alternative<InitHistory*>(var))
-						{
-							InitHistory* source = std::get<InitHistory*>(var);
-							assert(source->ope == EntityOperator::Construct);
-							functions = source->functions;
-							functions.mover(data, source->data);
-						}
+						assert(plan.source != nullptr);
+						move_storage_element(new_block, i, new_index, plan.block, std::get<size_t>(var), plan.index, component_size);
 					}
-					auto& entitys = new_block->entitys[new_element_index];
-					entitys = ite.first;
-					entitys->add_ref();
-					ite.first->set(find_result->second, new_block, new_element_index);
-					if (old_type_group != nullptr)
+					else if (std::holds_alternative<InitHistory*>(var))
 					{
-						auto& old_entitys = old_storage_block->entitys[old_element_index];
-						old_entitys->sub_ref();
-						old_entitys = nullptr;
-						old_type_group->release_group(old_storage_block, old_element_index);
+						InitHistory* source = std::get<InitHistory*>(var);
+						assert(source->ope == EntityOperator::Construct);
+						construct_storage_element(new_block, i, new_index, source->functions, source->data, component_size, version);
 					}
+				}
+				transfer_entity(plan.entity, plan.target, new_block, new_index, plan.source, plan.block, plan.index);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	void ComponentPool::run_parallel_task(ParallelTask& task) noexcept
+	{
+		for (size_t index = task.next.fetch_add(1, std::memory_order_relaxed); index < task.count; index = task.next.fetch_add(1, std::memory_order_relaxed))
+		{
+			try {
+				task.function(task.data, index);
+			}
+			catch (...)
+			{
+				std::lock_guard lg(task.exception_mutex);
+				if (!task.exception)
+					task.exception = std::current_exception();
+			}
+		}
+	}
+
+	template<typename Func> void ComponentPool::parallel_apply(size_t count, Func&& func)
+	{
+		ParallelTask task;
+		task.function = [](void* data, size_t index) { (*static_cast<std::remove_reference_t<Func>*>(data))(index); };
+		task.data = &func;
+		task.count = count;
+		// a single piece of work is not worth waking other threads
+		if (count > 1)
+		{
+			std::lock_guard lg(m_task_mutex);
+			m_tasks.push_back(&task);
+		}
+		run_parallel_task(task);
+		if (count > 1)
+		{
+			{
+				std::lock_guard lg(m_task_mutex);
+				m_tasks.erase(std::find(m_tasks.begin(), m_tasks.end(), &task));
+			}
+			while (task.helper.load(std::memory_order_acquire) != 0)
+				std::this_thread::yield();
+		}
+		if (task.exception)
+			std::rethrow_exception(task.exception);
+	}
+
+	void ComponentPool::parallel_execute(size_t count, void(*function)(void* data, size_t index), void* data)
+	{
+		assert(function != nullptr);
+		parallel_apply(count, [=](size_t index) { function(data, index); });
+	}
+
+	bool ComponentPool::help_update() noexcept
+	{
+		ParallelTask* task = nullptr;
+		{
+			std::lock_guard lg(m_task_mutex);
+			// idle threads are spread over the tasks which still have indices left
+			for (size_t i = 0; i < m_tasks.size() && task == nullptr; ++i)
+			{
+				ParallelTask* ite = m_tasks[(m_task_cursor + i) % m_tasks.size()];
+				if (ite->next.load(std::memory_order_relaxed) < ite->count)
+					task = ite;
+			}
+			if (task == nullptr)
+				return false;
+			++m_task_cursor;
+			task->helper.fetch_add(1, std::memory_order_relaxed);
+		}
+		run_parallel_task(*task);
+		task->helper.fetch_sub(1, std::memory_order_release);
+		return true;
+	}
 
+	void ComponentPool::insert_sparse(uint32_t entity, InitHistory& history)
+	{
+		size_t id = m_entity_pool.component_id(history.type);
+		if (m_sparse_set.size() <= id)
+			m_sparse_set.resize(id + 1);
+		auto& set = m_sparse_set[id];
+		if (!set)
+		{
+			set = std::make_unique<SparseComponentSet>();
+			set->type = history.type;
+			set->functions = history.functions;
+			set->stride = std::max(history.type.storage_size(), size_t(1));
+			size_t page_size = std::max(1024 * 8 - MemoryPageAllocator::reserved_size(), set->stride * 16 + history.type.align);
+			std::tie(page_size, std::ignore) = MemoryPageAllocator::pre_calculte_size(page_size);
+			set->page_element_count = (page_size - history.type.align) / set->stride;
+		}
+		size_t page = entity >> SparseComponentSet::sparse_page_bits;
+		if (set->sparse_pages.size() <= page)
+			set->sparse_pages.resize(page + 1);
+		if (!set->sparse_pages[page])
+			set->sparse_pages[page] = std::make_unique<size_t[]>(size_t(1) << SparseComponentSet::sparse_page_bits);
+		size_t& slot = *set->slot(entity);
+		size_t component_size = history.type.storage_size();
+		if (slot != 0)
+		{
+			// replacing keeps the dense index
+			void* target = set->data(slot - 1);
+			set->functions.destruct(target);
+			history.functions.move(target, history.data, component_size);
+			return;
+		}
+		if (set->count == set->dense_pages.size() * set->page_element_count)
+		{
+			auto [buffer, page_size] = m_allocator.allocate((set->page_element_count * set->stride) + history.type.align);
+			void* ptr = buffer;
+			auto result = std::align(history.type.align, set->page_element_count * set->stride, ptr, page_size);
+			assert(result != nullptr);
+			set->dense_pages.push_back({ buffer, reinterpret_cast<std::byte*>(ptr) });
+		}
+		history.functions.move(set->data(set->count), history.data, component_size);
+		set->entitys.push_back(entity);
+		slot = ++set->count;
+	}
+
+	void ComponentPool::erase_sparse(SparseComponentSet& set, uint32_t entity) noexcept
+	{
+		size_t* slot = set.slot(entity);
+		if (slot == nullptr || *slot == 0)
+			return;
+		size_t index = *slot - 1;
+		*slot = 0;
+		void* target = set.data(index);
+		set.functions.destruct(target);
+		size_t last = --set.count;
+		if (index != last)
+		{
+			// the last element fills the hole, so the dense pages stay packed
+			void* source = set.data(last);
+			set.functions.move(target, source, set.type.storage_size());
+			set.functions.destruct(source);
+			uint32_t moved = set.entitys[last];
+			set.entitys[index] = moved;
+			*set.slot(moved) = index + 1;
+		}
+		set.entitys.pop_back();
+		// keep one empty page against add and remove in turn
+		while (set.dense_pages.size() >= 2 && set.count <= (set.dense_pages.size() - 2) * set.page_element_count)
+		{
+			MemoryPageAllocator::release(set.dense_pages.back().first);
+			set.dense_pages.pop_back();
+		}
+	}
+
+	void ComponentPool::free_sparse_set(SparseComponentSet& set) noexcept
+	{
+		for (size_t i = 0; i < set.count; ++i)
+			set.functions.destruct(set.data(i));
+		for (auto& ite : set.dense_pages)
+			MemoryPageAllocator::release(ite.first);
+		set.dense_pages.clear();
+		set.entitys.clear();
+		set.sparse_pages.clear();
+		set.count = 0;
+	}
+
+	bool ComponentPool::update_sparse(uint32_t entity, InitHistory* histories, size_t count, bool& destory)
+	{
+		bool dense = false;
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto& ite = histories[i];
+			switch (ite.ope)
+			{
+			case EntityOperator::Construct:
+				if (ite.type.sparse)
+					insert_sparse(entity, ite);
+				else
+					dense = true;
+				break;
+			case EntityOperator::Destruct:
+				if (ite.type.sparse)
+				{
+					size_t id = m_entity_pool.find_component_id(ite.type);
+					if (id < m_sparse_set.size() && m_sparse_set[id])
+						erase_sparse(*m_sparse_set[id], entity);
+				}
+				else
+					dense = true;
+				break;
+			case EntityOperator::Destory:
+			case EntityOperator::DeleteAll:
+				for (auto& ite2 : m_sparse_set)
+					if (ite2)
+						erase_sparse(*ite2, entity);
+				if (ite.ope == EntityOperator::Destory)
+				{
+					destory = true;
+					return true;
+				}
+				dense = true;
+				break;
+			}
+		}
+		return dense;
+	}
+
+	void ComponentPool::update_batch(InitBatch& batch, uint64_t version, bool& new_type_group)
+	{
+		std::vector<TypeInfo> types = batch.types;
+		std::sort(types.begin(), types.end());
+		assert(std::adjacent_find(types.begin(), types.end()) == types.end());
+		TypeGroup* group = find_type_group({ types.data(), types.size() }, new_type_group);
+		std::vector<size_t> columns(batch.types.size());
+		for (size_t i = 0; i < batch.types.size(); ++i)
+			columns[i] = group->layouts().locate(batch.types[i]);
+		size_t done = 0;
+		while (done < batch.count)
+		{
+			auto [block, index, count] = group->allocate_range(m_allocator, batch.count - done);
+			for (size_t i = 0; i < batch.types.size(); ++i)
+			{
+				size_t column = columns[i];
+				size_t component_size = batch.types[i].storage_size();
+				auto& functions = batch.functions[i];
+				block->functions[column] = functions;
+				auto target = reinterpret_cast<std::byte*>(block->datas[column]) + component_size * index;
+				auto source = reinterpret_cast<std::byte*>(batch.columns[i]) + component_size * done;
+				if (functions.mover == nullptr)
+					functions.move(target, source, component_size * count);
+				else {
+					for (size_t k = 0; k < count; ++k)
+						functions.mover(target + component_size * k, source + component_size * k);
 				}
+				block->changed_versions[column] = version;
+				block->added_versions[column] = version;
+			}
+			for (size_t k = 0; k < count; ++k)
+			{
+				EntityId entity = batch.entitys[done + k];
+				assert(m_entity_pool.find(entity) != nullptr && m_entity_pool.find(entity)->block == nullptr);
+				block->entitys[index + k] = entity.index;
+				m_entity_pool.locate(entity.index, block, index + k);
+			}
+			done += count;
+		}
+	}
+
+	const SparseComponentSet* ComponentPool::find_sparse_set(const TypeInfo& type) const noexcept
+	{
+		size_t id = m_entity_pool.find_component_id(type);
+		return id < m_sparse_set.size() ? m_sparse_set[id].get() : nullptr;
+	}
+
+	bool ComponentPool::update()
+	{
+		std::lock_guard lg(m_init_lock);
+		std::unique_lock ul(m_type_group_mutex);
+		bool new_type_group = false;
+		for (auto& ite : m_reserve_history)
+		{
+			if (ite.shrink)
+			{
+				TypeGroup* group = find_type_group({ ite.types.data(), ite.types.size() });
+				if (group != nullptr)
+					group->shrink_to_fit();
+			}
+			else
+				find_type_group({ ite.types.data(), ite.types.size() }, new_type_group)->reserve(m_allocator, ite.count);
+		}
+		m_reserve_history.clear();
+		// components constructed here are visible to Changed and Added of every system
+		uint64_t version = increase_version();
+		// drain every thread, operations of one thread keep their order and threads are ordered by the creation of their buffers
+		CommandRecord record;
+		drain_buffers(record);
+		auto& histories = record.histories;
+		auto& batches = record.batches;
+		std::sort(batches.begin(), batches.end(), [](const InitBatch& i1, const InitBatch& i2) {
+			return std::tie(i1.record_buffer, i1.sequence) < std::tie(i2.record_buffer, i2.sequence);
+		});
+		std::sort(histories.begin(), histories.end(), [](const InitHistory& i1, const InitHistory& i2) {
+			return std::tie(i1.entity.index, i1.entity.generation, i1.buffer, i1.sequence) < std::tie(i2.entity.index, i2.entity.generation, i2.buffer, i2.sequence);
+		});
+		// entities of batches have no component before, later operations on them apply on top
+		for (auto& ite : batches)
+			update_batch(ite, version, new_type_group);
+		batches.clear();
+		std::vector<HistoryPlan> plans;
+		// slots of destoried entities are reused after the plans are applied
+		std::vector<uint32_t> destoried;
+		for (size_t start = 0, end = 0; start < histories.size(); start = end)
+		{
+			EntityId entity = histories[start].entity;
+			for (end = start + 1; end < histories.size() && histories[end].entity.index == entity.index && histories[end].entity.generation == entity.generation; ++end);
+			// recorded through a handle of an entity destoried before
+			if (m_entity_pool.find(entity) == nullptr)
+				continue;
+			bool destory = false;
+			bool dense = update_sparse(entity.index, histories.data() + start, end - start, destory);
+			if (destory)
+				destoried.push_back(entity.index);
+			if (!dense)
+				continue;
+			HistoryPlan plan;
+			plan.entity = entity.index;
+			plan.begin = histories.data() + start;
+			plan.end = histories.data() + end;
+			plans.push_back(std::move(plan));
+		}
+		if (!plans.empty())
+		{
+			constexpr size_t plan_step = 64;
+			parallel_apply((plans.size() + plan_step - 1) / plan_step, [&](size_t index) {
+				for (size_t i = index * plan_step; i < std::min(plans.size(), (index + 1) * plan_step); ++i)
+					plan_history(plans[i]);
+			});
+			for (auto& ite : plans)
+				prepare_history(ite, new_type_group);
+			// entities sharing a source or target group go to the same partition, partitions touch disjoint groups
+			std::unordered_map<TypeGroup*, size_t> group_index;
+			for (size_t i = 0; i < m_type_group.size(); ++i)
+				group_index.insert({ m_type_group[i], i });
+			std::vector<size_t> parent(m_type_group.size());
+			for (size_t i = 0; i < parent.size(); ++i)
+				parent[i] = i;
+			auto find_root = [&](size_t index) {
+				while (parent[index] != index)
+					index = parent[index] = parent[parent[index]];
+				return index;
+			};
+			auto plan_root = [&](const HistoryPlan& plan) {
+				return find_root(group_index[plan.source != nullptr ? plan.source : plan.target]);
+			};
+			for (auto& ite : plans)
+			{
+				if (ite.ope != PlanOperator::None && ite.source != nullptr && ite.target != nullptr)
+					parent[find_root(group_index[ite.source])] = find_root(group_index[ite.target]);
+			}
+			std::vector<size_t> partition_index(parent.size(), std::numeric_limits<size_t>::max());
+			std::vector<std::vector<HistoryPlan*>> partitions;
+			for (auto& ite : plans)
+			{
+				if (ite.ope == PlanOperator::None)
+					continue;
+				size_t& index = partition_index[plan_root(ite)];
+				if (index == std::numeric_limits<size_t>::max())
+				{
+					index = partitions.size();
+					partitions.emplace_back();
+				}
+				partitions[index].push_back(&ite);
+			}
+			parallel_apply(partitions.size(), [&](size_t index) {
+				for (auto ite : partitions[index])
+					apply_history(*ite, version);
+			});
+		}
+		for (auto ite : destoried)
+			m_entity_pool.release(ite);
+		destoried.clear();
+		plans.clear();
+		record.clear();
+		for (auto& ite : m_destory_history)
+		{
+			for (auto group : m_type_group)
+			{
+				if (group->available_count() == 0 || !group->layouts().hold_ordered(ite.data(), ite.size()))
+					continue;
+				for (auto block = group->top_block(); block != nullptr; block = block->next)
+				{
+					for (size_t i = 0; i < block->available_count; ++i)
+					{
+						if (block->entitys[i] != EntityId::invalid_index)
+							destoried.push_back(block->entitys[i]);
+					}
+				}
+				// sparse components go with their entities
+				for (auto& ite2 : m_sparse_set)
+				{
+					if (!ite2 || ite2->count == 0)
+						continue;
+					for (auto entity : destoried)
+						erase_sparse(*ite2, entity);
+				}
+				group->release_all();
+				for (auto entity : destoried)
+					m_entity_pool.release(entity);
+				destoried.clear();
+			}
+		}
+		m_destory_history.clear();
+		if (!m_type_group.empty())
+		{
+			size_t move_budget = m_compaction_move_budget;
+			if (move_budget == 0)
+				move_budget = std::numeric_limits<size_t>::max();
+			std::chrono::microseconds time_budget = m_compaction_time_budget;
+			auto deadline = (time_budget.count() == 0) ? std::chrono::steady_clock::time_point::max() : std::chrono::steady_clock::now() + time_budget;
+			// continue from the group where the last tick ran out of budget
+			size_t group_count = m_type_group.size();
+			size_t start = m_compaction_start % group_count;
+			if (move_budget == std::numeric_limits<size_t>::max())
+			{
+				// groups are compacted side by side, only the deadline is shared
+				std::vector<char> finished(group_count, false);
+				parallel_apply(group_count, [&](size_t index) {
+					size_t budget = std::numeric_limits<size_t>::max();
+					finished[index] = m_type_group[(start + index) % group_count]->update(budget, deadline);
+				});
+				auto find_result = std::find(finished.begin(), finished.end(), false);
+				if (find_result != finished.end())
+					m_compaction_start = (start + (find_result - finished.begin())) % group_count;
 			}
 			else {
-				if (old_type_group != nullptr)
+				for (size_t i = 0; i < group_count; ++i)
 				{
-					old_type_group->release_group(old_storage_block, old_element_index);
+					if (!m_type_group[(start + i) % group_count]->update(move_budget, deadline))
+					{
+						m_compaction_start = (start + i) % group_count;
+						break;
+					}
 				}
 			}
 		}
-		m_init_block.clear();
-		m_init_history.clear();
-		for (auto& ite : m_data)
-			ite.second->update();
 		return new_type_group;
 	}
 
 	void ComponentPool::search_type_group(
 		const TypeInfo* require_tl, size_t require_tl_count,
+		size_t begin, size_t end,
 		TypeGroup** output_tg,
 		size_t* output_tl_index
 	) const noexcept
 	{
-		size_t k = 0;
-		for (auto& ite : m_data)
+		assert(begin <= end && end <= m_type_group.size());
+		std::vector<size_t> ids(require_tl_count);
+		std::vector<uint64_t> signature;
+		bool exist = true;
+		for (size_t i = 0; i < require_tl_count; ++i)
+		{
+			// sparse components are joined by iterators
+			if (require_tl[i].sparse)
+				continue;
+			size_t id = m_entity_pool.find_component_id(require_tl[i]);
+			if (id == EntityPool::invalid_component_id)
+			{
+				exist = false;
+				break;
+			}
+			ids[i] = id;
+			if (signature.size() <= id / 64)
+				signature.resize(id / 64 + 1, 0);
+			signature[id / 64] |= uint64_t(1) << (id % 64);
+		}
+		for (size_t k = 0; k < end - begin; ++k)
 		{
-			if (ite.first.locate_unordered(require_tl, output_tl_index + k * require_tl_count, require_tl_count))
-				output_tg[k] = ite.second;
+			TypeGroup* group = m_type_group[begin + k];
+			if (exist && group->match(signature.data(), signature.size()))
+			{
+				output_tg[k] = group;
+				for (size_t i = 0; i < require_tl_count; ++i)
+					output_tl_index[k * require_tl_count + i] = require_tl[i].sparse ? 0 : group->column(ids[i]);
+			}
 			else
 				output_tg[k] = nullptr;
-			++k;
 		}
 	}
 
 	size_t ComponentPool::find_top_block(TypeGroup** tg, StorageBlock** output, size_t length) const noexcept
 	{
-		size_t data_count = m_data.size();
-		assert(length == data_count);
 		size_t total = 0;
 		for (size_t i = 0; i < length; ++i)
 		{
@@ -687,20 +1652,22 @@ namespace Noodles::Implement
 
 	size_t ComponentPool::type_group_count() const noexcept
 	{
-		return m_data.size();
+		return m_type_group.size();
 	}
 
 	void ComponentPool::update_type_group_state(std::vector<bool>& tar)
 	{
-		tar.resize(m_data.size());
-		size_t i = 0;
-		for (auto& ite : m_data)
-			tar[i++] = (ite.second->top_block() != nullptr);
+		tar.resize(m_type_group.size());
+		for (size_t i = 0; i < m_type_group.size(); ++i)
+			tar[i] = (m_type_group[i]->top_block() != nullptr);
 	}
 
 
 	ComponentPool::~ComponentPool()
 	{
 		clean_all();
+		std::lock_guard lg(m_buffer_lock);
+		for (auto& ite : m_buffers)
+			ite->closed.store(true, std::memory_order_release);
 	}
 }
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include <set>
 #include <deque>
 #include <variant>
+#include <limits>
+#include <unordered_map>
+#include <thread>
 namespace Noodles::Implement
 {
 	struct TypeLayoutArray
@@ -21,6 +24,7 @@ namespace Noodles::Implement
 		}
 
 		size_t locate(const TypeInfo& input) const noexcept;
+		uint64_t hash() const noexcept;
 		bool locate_ordered(const TypeInfo* input, size_t* output, size_t length) const noexcept;
 		bool locate_unordered(const TypeInfo* input, size_t* output, size_t length) const noexcept;
 
@@ -31,38 +35,116 @@ namespace Noodles::Implement
 		bool hold_unordered(const TypeInfo* input, size_t length) const noexcept { return locate_unordered(input, nullptr, length); }
 	};
 
+	struct TypeGroup;
+
+	// applied to type groups created after it is set
+	struct StorageLayoutPolicy
+	{
+		// columns start at this boundary at least, so writers of different columns do not share a cache line
+		size_t column_align = 64;
+		// the capacity of a block is rounded down to a multiple of it
+		size_t capacity_step = 8;
+		size_t min_element_count = 32;
+		size_t min_page_size = 1024 * 8;
+		// page size doubles once a group holds more elements than grow_block_count blocks, up to max_page_size
+		size_t max_page_size = 1024 * 256;
+		size_t grow_block_count = 16;
+	};
+
+	// transition to the group with one more or one less component
+	struct TypeGroupEdge
+	{
+		TypeGroup* target = nullptr;
+		// for each column of target, the column of the source group, or the column count of the source for the added one
+		std::vector<size_t> columns;
+	};
+
 	struct TypeGroup
 	{
 		TypeLayoutArray layouts() const noexcept { return m_type_layouts; }
-		static TypeGroup* create(TypeLayoutArray array);
+		static TypeGroup* create(TypeLayoutArray array, const StorageLayoutPolicy& policy, EntityTable* table);
 		static void free(TypeGroup*);
+		EntityTable* entity_table() const noexcept { return m_entity_table; }
 
 		size_t element_count() const noexcept { return m_element_count; }
 		size_t page_size() const noexcept { return m_page_size; }
+		size_t column_align() const noexcept { return m_policy.column_align; }
+		// set when the first element of each column is placed
+		StorageBlockFunctionPair* functions() noexcept { return m_functions.data(); }
 		
 		std::tuple<StorageBlock*, size_t> allocate_group(MemoryPageAllocator& allocator);
+		// consecutive slots after the last element, no more than count, holes are left to compaction
+		std::tuple<StorageBlock*, size_t, size_t> allocate_range(MemoryPageAllocator& allocator, size_t count);
 		void release_group(StorageBlock* block, size_t);
-		void update();
+		// release every element and block at once, blocks kept by reserve stay
+		void release_all() noexcept;
+		// fill holes with elements from the tail, return false if the budget runs out first
+		bool update(size_t& move_budget, std::chrono::steady_clock::time_point deadline);
 		StorageBlock* top_block() const noexcept { return m_start_block; }
 		size_t available_count() const noexcept { return m_available_count; }
+		size_t capacity() const noexcept { return m_capacity; }
+		void reserve(MemoryPageAllocator& allocator, size_t count);
+		void shrink_to_fit() noexcept;
+		const TypeGroupEdge* find_edge(const TypeInfo& type, bool add) const noexcept;
+		const TypeGroupEdge& insert_edge(const TypeInfo& type, bool add, TypeGroup* target);
+		uint64_t hash() const noexcept { return m_hash; }
+		// ids are the dense component ids of each column
+		void set_signature(const size_t* ids) noexcept;
+		bool match(const uint64_t* signature, size_t word_count) const noexcept;
+		size_t column(size_t id) const noexcept { return id < m_id_column.size() ? m_id_column[id] : m_type_layouts.count; }
+		bool hold(size_t id) const noexcept { return id / 64 < m_signature.size() && (m_signature[id / 64] & (uint64_t(1) << (id % 64))) != 0; }
 
 	private:
 
 		void remove_page_from_list(StorageBlock*);
 		void insert_page_to_list(StorageBlock*);
+		void remove_page_from_partial_list(StorageBlock*) noexcept;
+		void insert_page_to_partial_list(StorageBlock*) noexcept;
 		void inside_move(StorageBlock* source, size_t sindex, StorageBlock* target, size_t tindex);
-
-		TypeGroup(TypeLayoutArray);
+		void recycle_storage_block(StorageBlock*) noexcept;
+		StorageBlock* new_storage_block(MemoryPageAllocator& allocator);
+		void append_storage_block(MemoryPageAllocator& allocator, size_t expected_count);
+		void delete_storage_block(StorageBlock*) noexcept;
+		void set_page_size(size_t page_size) noexcept;
+		// larger blocks for groups with many elements
+		void grow_page_size(size_t count) noexcept;
+
+		TypeGroup(TypeLayoutArray, const StorageLayoutPolicy&, EntityTable*);
 		~TypeGroup();
 		
 		TypeLayoutArray m_type_layouts;
 		StorageBlock* m_start_block = nullptr;
 		StorageBlock* m_last_block = nullptr;
 
+		StorageLayoutPolicy m_policy;
+		size_t m_element_size = 0;
+		size_t m_fixed_size = 0;
+		// used by the next created block, blocks created before keep their own capacity
 		size_t m_page_size;
 		size_t m_element_count;
 		size_t m_available_count = 0;
-		std::map<StorageBlock*, size_t> m_deleted_page;
+		size_t m_capacity = 0;
+		// blocks which have released slots since the last update
+		StorageBlock* m_partial_block = nullptr;
+
+		// empty blocks kept out of the iterated list
+		StorageBlock* m_reserved_block = nullptr;
+		size_t m_block_count = 0;
+		size_t m_reserved_block_count = 0;
+		size_t m_reserved_capacity = 0;
+
+		std::unordered_map<TypeInfo, TypeGroupEdge, TypeInfoHasher> m_add_edges;
+		std::unordered_map<TypeInfo, TypeGroupEdge, TypeInfoHasher> m_remove_edges;
+
+		std::vector<StorageBlockFunctionPair> m_functions;
+
+		uint64_t m_hash = 0;
+		// bitset over dense component ids, and the column of each id
+		std::vector<uint64_t> m_signature;
+		std::vector<size_t> m_id_column;
+
+		// slots of the entities are updated when they move
+		EntityTable* m_entity_table = nullptr;
 	};
 
 	struct InitHistory
@@ -78,19 +160,43 @@ namespace Noodles::Implement
 		virtual size_t type_group_count() const noexcept override;
 		virtual void search_type_group(
 			const TypeInfo* require_tl, size_t require_tl_count,
+			size_t begin, size_t end,
 			TypeGroup** output_tg,
 			size_t* output_tl_index
 		) const noexcept override;
 
-		virtual void handle_entity_imp(EntityInterface*, EntityOperator ope) noexcept override;
+		virtual EntityTable* entity_table() noexcept override { return &m_entity_pool; }
+		virtual void allocate_entity(EntityId* output, size_t count) override;
+		virtual void handle_entity_imp(EntityId, EntityOperator ope) noexcept override;
 		virtual void construct_component(
 			const TypeInfo& layout, void(*constructor)(void*, void*), void* data,
-			EntityInterface*, void(*deconstructor)(void*) noexcept, void(*mover)(void*, void*) noexcept
+			EntityId, void(*deconstructor)(void*) noexcept, void(*mover)(void*, void*) noexcept
 		) override;
 		virtual size_t find_top_block(TypeGroup** tg, StorageBlock ** output, size_t length) const noexcept override;
-		virtual void deconstruct_component(EntityInterface*, const TypeInfo& layout) noexcept override;
+		virtual void deconstruct_component(EntityId, const TypeInfo& layout) noexcept override;
+		virtual void construct_components(
+			const TypeInfo* layouts, const StorageBlockFunctionPair* functions, size_t type_count,
+			const EntityId* entities, size_t count, void(*constructor)(void** columns, size_t count, void* parameter), void* parameter
+		) override;
+		virtual void reserve_type_group(const TypeInfo* layouts, size_t count, size_t reserve_count) override;
+		virtual void shrink_type_group(const TypeInfo* layouts, size_t count) override;
+		virtual void destory_type_groups(const TypeInfo* layouts, size_t count) override;
+		virtual uint64_t increase_version() noexcept override { return ++m_version; }
+		virtual const SparseComponentSet* find_sparse_set(const TypeInfo& type) const noexcept override;
+		virtual void parallel_execute(size_t count, void(*function)(void* data, size_t index), void* data) override;
 		bool update();
+		// called by idle threads, take a share of the work of a running update or parallel_execute, return false if there is none
+		bool help_update() noexcept;
 		void update_type_group_state(std::vector<bool>& ite);
+		// 0 means unlimited, holes left by the budget are skipped by iterators and filled in later ticks
+		void set_compaction_budget(size_t move, std::chrono::microseconds duration) noexcept {
+			m_compaction_move_budget = move;
+			m_compaction_time_budget = duration;
+		}
+		void set_storage_layout_policy(const StorageLayoutPolicy& policy) noexcept {
+			std::lock_guard lg(m_init_lock);
+			m_layout_policy = policy;
+		}
 		void clean_all();
 		ComponentPool(MemoryPageAllocator& allocator) noexcept;
 		~ComponentPool();
@@ -112,22 +218,222 @@ namespace Noodles::Implement
 
 		struct InitHistory
 		{
+			EntityId entity;
+			// index of the recording buffer, then order of recording in that buffer
+			size_t buffer;
+			uint64_t sequence;
 			EntityOperator ope;
 			TypeInfo type;
 			StorageBlockFunctionPair functions;
 			void* data;
-			InitHistory(EntityOperator i, const TypeInfo& t, StorageBlockFunctionPair p, void* d)
-				: ope(i), type(t), functions(p), data(d) {}
+			InitHistory(EntityId e, size_t b, uint64_t s, EntityOperator i, const TypeInfo& t, StorageBlockFunctionPair p, void* d)
+				: entity(e), buffer(b), sequence(s), ope(i), type(t), functions(p), data(d) {}
+			// staged data is destructed once, by the last owner
+			InitHistory(InitHistory&& history) noexcept
+				: entity(history.entity), buffer(history.buffer), sequence(history.sequence), ope(history.ope), type(history.type), functions(history.functions), data(history.data) {
+				history.data = nullptr;
+			}
+			InitHistory& operator=(InitHistory&& history) noexcept {
+				std::swap(entity, history.entity);
+				std::swap(buffer, history.buffer);
+				std::swap(sequence, history.sequence);
+				std::swap(ope, history.ope);
+				std::swap(type, history.type);
+				std::swap(functions, history.functions);
+				std::swap(data, history.data);
+				return *this;
+			}
 			~InitHistory();
 		};
 
+		// components of create_entities, staged column by column
+		struct InitBatch
+		{
+			std::vector<TypeInfo> types;
+			std::vector<StorageBlockFunctionPair> functions;
+			std::vector<void*> columns;
+			std::vector<EntityId> entitys;
+			std::byte* buffer = nullptr;
+			size_t count = 0;
+			size_t record_buffer = 0;
+			uint64_t sequence = 0;
+			InitBatch() = default;
+			InitBatch(InitBatch&& batch) noexcept
+				: types(std::move(batch.types)), functions(std::move(batch.functions)), columns(std::move(batch.columns)),
+				entitys(std::move(batch.entitys)), buffer(batch.buffer), count(batch.count), record_buffer(batch.record_buffer), sequence(batch.sequence) {
+				batch.buffer = nullptr;
+				batch.count = 0;
+			}
+			InitBatch& operator=(InitBatch&& batch) noexcept {
+				std::swap(types, batch.types);
+				std::swap(functions, batch.functions);
+				std::swap(columns, batch.columns);
+				std::swap(entitys, batch.entitys);
+				std::swap(buffer, batch.buffer);
+				std::swap(count, batch.count);
+				std::swap(record_buffer, batch.record_buffer);
+				std::swap(sequence, batch.sequence);
+				return *this;
+			}
+			~InitBatch();
+		};
+
+		struct ReserveHistory
+		{
+			std::vector<TypeInfo> types;
+			size_t count;
+			bool shrink;
+		};
+
+		struct CommandRecord
+		{
+			std::vector<InitBlock> blocks;
+			std::vector<InitHistory> histories;
+			std::vector<InitBatch> batches;
+			void clear() noexcept;
+		};
+
+		// recorded by one thread with its own staging blocks and no lock, the owner appends to records[current] while writing is not zero,
+		// update flips side and waits for the running appends before it drains the other one
+		struct CommandBuffer
+		{
+			size_t serial = 0;
+			// order of buffers in the pool, breaks the ties between threads
+			size_t index = 0;
+			// only touched by the owner thread
+			uint64_t sequence = 0;
+			size_t current = 0;
+			std::atomic_size_t side = 0;
+			// depth of nested RecordScope, a constructor may record again
+			std::atomic_size_t writing = 0;
+			// set when the owner thread exits, the buffer is dropped after it is drained
+			std::atomic_bool retired = false;
+			// set when the pool is destructed, the owner thread drops its reference
+			std::atomic_bool closed = false;
+			CommandRecord records[2];
+		};
+
+		struct RecordScope
+		{
+			CommandRecord& record;
+			RecordScope(CommandBuffer& buffer) noexcept : record(begin(buffer)), m_buffer(buffer) {}
+			~RecordScope() { m_buffer.writing.fetch_sub(1, std::memory_order_release); }
+			size_t buffer() const noexcept { return m_buffer.index; }
+			uint64_t next_sequence() noexcept { return m_buffer.sequence++; }
+		private:
+			// the side is only chosen by the outermost scope, nested ones append to the same record
+			static CommandRecord& begin(CommandBuffer& buffer) noexcept {
+				if (buffer.writing.fetch_add(1) == 0)
+					buffer.current = buffer.side.load();
+				return buffer.records[buffer.current];
+			}
+			CommandBuffer& m_buffer;
+		};
+
+		// buffers of the calling thread, one for each pool it records to
+		struct LocalCommandBuffers
+		{
+			std::vector<std::shared_ptr<CommandBuffer>> buffers;
+			~LocalCommandBuffers();
+		};
+
+		CommandBuffer& local_buffer();
+		void* stage_component(CommandRecord& record, const TypeInfo& layout);
+		// move records of every thread to output, buffers of exited threads are dropped
+		void drain_buffers(CommandRecord& output);
+
+		enum class PlanOperator
+		{
+			None,
+			// remove every component
+			Release,
+			// first component of an entity without group
+			Root,
+			// a single construction or destruction through the edge of the group
+			Edge,
+			// replace components in place, or move to the target group
+			Move,
+		};
+
+		// what the histories of one entity do, planned in parallel and applied by the partition holding its groups
+		struct HistoryPlan
+		{
+			uint32_t entity = EntityId::invalid_index;
+			InitHistory* begin = nullptr;
+			InitHistory* end = nullptr;
+			PlanOperator ope = PlanOperator::None;
+			TypeGroup* source = nullptr;
+			StorageBlock* block = nullptr;
+			size_t index = 0;
+			TypeGroup* target = nullptr;
+			const TypeGroupEdge* edge = nullptr;
+			std::vector<TypeInfo> layouts;
+			std::vector<std::variant<size_t, InitHistory*>> states;
+		};
+
+		// indices shared by the calling thread and the idle threads
+		struct ParallelTask
+		{
+			void(*function)(void* data, size_t index) = nullptr;
+			void* data = nullptr;
+			size_t count = 0;
+			std::atomic_size_t next = 0;
+			std::atomic_size_t helper = 0;
+			std::mutex exception_mutex;
+			std::exception_ptr exception;
+		};
+
+		template<typename Func> void parallel_apply(size_t count, Func&& func);
+		static void run_parallel_task(ParallelTask& task) noexcept;
+
+		TypeGroup* find_type_group(TypeLayoutArray layouts) const noexcept;
+		TypeGroup* find_type_group(TypeLayoutArray layouts, bool& new_type_group);
+		const TypeGroupEdge& find_type_group_edge(TypeGroup* source, const TypeInfo& type, bool add, bool& new_type_group);
+		// only reads the type groups
+		void plan_history(HistoryPlan& plan) const;
+		// create the groups and edges the plan needs
+		void prepare_history(HistoryPlan& plan, bool& new_type_group);
+		void apply_history(HistoryPlan& plan, uint64_t version);
+		// apply the operations of sparse components, return false if nothing is left for type groups
+		bool update_sparse(uint32_t entity, InitHistory* histories, size_t count, bool& destory);
+		void update_batch(InitBatch& batch, uint64_t version, bool& new_type_group);
+		void insert_sparse(uint32_t entity, InitHistory& history);
+		void erase_sparse(SparseComponentSet& set, uint32_t entity) noexcept;
+		void free_sparse_set(SparseComponentSet& set) noexcept;
+
 		std::shared_mutex m_type_group_mutex;
 		MemoryPageAllocator& m_allocator;
-		std::map<TypeLayoutArray, TypeGroup*> m_data;
+		// keyed by TypeLayoutArray::hash, m_type_group keeps the order of creation
+		std::unordered_multimap<uint64_t, TypeGroup*> m_data;
+		std::vector<TypeGroup*> m_type_group;
+		StorageLayoutPolicy m_layout_policy;
+		// indexed by component id, groups of a single component for entities without group
+		std::vector<TypeGroup*> m_root_group;
+		std::vector<std::unique_ptr<SparseComponentSet>> m_sparse_set;
 
 		std::mutex m_init_lock;
-		std::vector<InitBlock> m_init_block;
-		std::map<EntityInterfacePtr, std::vector<InitHistory>> m_init_history;
+		std::vector<ReserveHistory> m_reserve_history;
+		std::vector<std::vector<TypeInfo>> m_destory_history;
+
+		// buffers are shared with the threads recording to them
+		const size_t m_serial;
+		std::mutex m_buffer_lock;
+		std::vector<std::shared_ptr<CommandBuffer>> m_buffers;
+		size_t m_buffer_count = 0;
+
+		// also assigns the component ids, cached by types with m_serial
+		EntityPool m_entity_pool;
+
+		// tasks of update and of systems running at the same time
+		std::mutex m_task_mutex;
+		std::vector<ParallelTask*> m_tasks;
+		size_t m_task_cursor = 0;
+
+		std::atomic_size_t m_compaction_move_budget = 0;
+		std::atomic<std::chrono::microseconds> m_compaction_time_budget = std::chrono::microseconds{ 0 };
+		size_t m_compaction_start = 0;
+
+		std::atomic_uint64_t m_version = 0;
 		
 	};
 
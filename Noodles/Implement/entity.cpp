@@ -3,48 +3,105 @@
 namespace Noodles::Implement
 {
 
-	void EntityImp::read(TypeGroup*& a, StorageBlock*& b, size_t& index) const noexcept
+	bool EntityPool::have(EntityId id, const size_t* component_ids, const bool* sparse, size_t count) const noexcept
 	{
-		a = m_type_group; b = m_storage_block; index = m_index;
+		const EntitySlot* slot = find(id);
+		if (slot == nullptr)
+			return false;
+		for (size_t i = 0; i < count; ++i)
+		{
+			size_t component = component_ids[i];
+			if (sparse[i])
+			{
+				if (component >= m_sparse_set.size() || !m_sparse_set[component] || m_sparse_set[component]->find(id.index) == nullptr)
+					return false;
+			}
+			else if (slot->block == nullptr || !slot->block->m_owner->hold(component))
+				return false;
+		}
+		return true;
 	}
 
-	void EntityImp::set(TypeGroup* a, StorageBlock* b, size_t index) noexcept
+	size_t EntityPool::component_id(const TypeInfo& type)
 	{
-		m_type_group = a;
-		m_storage_block = b;
-		m_index = index;
+		{
+			std::shared_lock sl(m_component_id_mutex);
+			auto ite = m_component_id.find(type);
+			if (ite != m_component_id.end())
+				return ite->second;
+		}
+		std::unique_lock ul(m_component_id_mutex);
+		return m_component_id.insert({ type, m_component_id.size() }).first->second;
 	}
 
-	bool EntityImp::have(const TypeInfo* ty, size_t index) const noexcept
+	size_t EntityPool::find_component_id(const TypeInfo& type) const noexcept
 	{
-		if (index == 0)
-			return true;
-		else if (m_type_group != nullptr)
+		std::shared_lock sl(m_component_id_mutex);
+		auto ite = m_component_id.find(type);
+		return ite != m_component_id.end() ? ite->second : invalid_component_id;
+	}
+
+	void EntityPool::allocate(EntityId* output, size_t count)
+	{
+		std::lock_guard lg(m_mutex);
+		size_t i = 0;
+		for (; i < count && !m_free.empty(); ++i)
 		{
-			return m_type_group->layouts().hold_unordered(ty, index);
+			uint32_t index = m_free.back();
+			m_free.pop_back();
+			output[i] = id(index);
+		}
+		for (; i < count; ++i)
+		{
+			assert(m_count != EntityId::invalid_index);
+			uint32_t index = m_count++;
+			EntitySlot*& chunk = m_chunks[index >> chunk_bits];
+			if (chunk == nullptr)
+				chunk = new EntitySlot[size_t(1) << chunk_bits]{};
+			output[i] = id(index);
 		}
-		else
-			return false;
 	}
 
-	void EntityImp::add_ref() const noexcept
+	void EntityPool::release(uint32_t index) noexcept
 	{
-		m_ref.add_ref();
+		std::lock_guard lg(m_mutex);
+		EntitySlot& target = slot(index);
+		target.block = nullptr;
+		target.index = 0;
+		++target.generation;
+		m_free.push_back(index);
 	}
 
-	void EntityImp::sub_ref() const noexcept
+	void EntityPool::release_all() noexcept
 	{
-		if (m_ref.sub_ref())
-			delete this;
+		std::lock_guard lg(m_mutex);
+		std::vector<bool> freed(m_count, false);
+		for (uint32_t index : m_free)
+			freed[index] = true;
+		for (uint32_t index = 0; index < m_count; ++index)
+		{
+			if (!freed[index])
+			{
+				EntitySlot& target = slot(index);
+				target.block = nullptr;
+				target.index = 0;
+				++target.generation;
+				m_free.push_back(index);
+			}
+		}
 	}
 
-	intrusive_ptr<EntityImp> EntityImp::create_one()
+	EntityPool::EntityPool(uint32_t serial, const std::vector<std::unique_ptr<SparseComponentSet>>& sparse_set)
+		: m_sparse_set(sparse_set)
 	{
-		return new EntityImp{};
+		m_serial = serial;
+		m_chunks = new EntitySlot * [chunk_count]();
 	}
 
-	EntityImp::~EntityImp()
+	EntityPool::~EntityPool()
 	{
-		assert(m_type_group == nullptr);
+		for (size_t i = 0; i < chunk_count; ++i)
+			delete[] m_chunks[i];
+		delete[] m_chunks;
 	}
-}
\ No newline at end of file
+}
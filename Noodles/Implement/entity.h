@@ -1,33 +1,44 @@
 #pragma once
+#include <mutex>
+#include <vector>
+#include <memory>
 #include <shared_mutex>
+#include <unordered_map>
 #include "../interface.h"
 
 namespace Noodles::Implement
 {
 	struct ComponentMemoryPageDesc;
 
-	struct EntityImp : EntityInterface
+	struct TypeInfoHasher
 	{
-		virtual void add_ref() const noexcept override;
-		virtual void sub_ref() const noexcept override;
-
-		virtual void read(TypeGroup*&, StorageBlock*&, size_t& index) const noexcept override;
-		virtual void set(TypeGroup*, StorageBlock*, size_t index) noexcept override;
-		virtual bool have(const TypeInfo*, size_t index) const noexcept override;
-
-		static intrusive_ptr<EntityImp> create_one();
+		size_t operator()(const TypeInfo& info) const noexcept { return info.hash_code; }
+	};
 
-		~EntityImp();
+	struct EntityPool : EntityTable
+	{
+		static constexpr size_t invalid_component_id = std::numeric_limits<size_t>::max();
+		virtual bool have(EntityId id, const size_t* component_ids, const bool* sparse, size_t count) const noexcept override;
+		virtual size_t component_id(const TypeInfo& type) override;
+		// invalid_component_id if the type is never used
+		size_t find_component_id(const TypeInfo& type) const noexcept;
+
+		// called from any thread
+		void allocate(EntityId* output, size_t count);
+		// called in ComponentPool::update, the generation is increased so that the old handles could not find it
+		void release(uint32_t index) noexcept;
+		void release_all() noexcept;
+
+		// sparse sets of the owner, indexed by component id
+		EntityPool(uint32_t serial, const std::vector<std::unique_ptr<SparseComponentSet>>& sparse_set);
+		~EntityPool();
 	private:
+		std::mutex m_mutex;
+		uint32_t m_count = 0;
+		std::vector<uint32_t> m_free;
 
-		EntityImp() = default;
-
-		mutable std::shared_mutex m_comps_mutex;
-		TypeGroup* m_type_group = nullptr;
-		StorageBlock* m_storage_block = nullptr;
-		size_t m_index = 0;
-		mutable Potato::Tool::atomic_reference_count m_ref;
+		mutable std::shared_mutex m_component_id_mutex;
+		std::unordered_map<TypeInfo, size_t, TypeInfoHasher> m_component_id;
+		const std::vector<std::unique_ptr<SparseComponentSet>>& m_sparse_set;
 	};
-
-	using EntityImpPtr = Potato::Tool::intrusive_ptr<EntityImp>;
-}
\ No newline at end of file
+}
@@ -8,7 +8,7 @@ namespace Noodles::Implement
 		: m_allocator(allocator), m_layout(layout)
 	{
 		size_t aligned_space = (layout.align > sizeof(nullptr) ? layout.align - sizeof(nullptr) : 0);
-		size_t target_size = sizeof(EventPoolMemoryDescription) + aligned_space + (sizeof(void (*)(void*) noexcept) + layout.size) * min_page_event_count;
+		target_size = sizeof(EventPoolMemoryDescription) + aligned_space + (sizeof(void (*)(void*) noexcept) + layout.size) * min_page_event_count;
 		auto [i,k] = MemoryPageAllocator::pre_calculte_size(target_size);
 		target_size = i;
 		max_event_count = target_size - sizeof(EventPoolMemoryDescription) - aligned_space;
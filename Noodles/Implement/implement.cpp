@@ -2,6 +2,26 @@
 #include "platform.h"
 namespace Noodles
 {
+	namespace
+	{
+		thread_local ContextImplement* local_frame_owner = nullptr;
+		thread_local Implement::FrameMemoryResource* local_frame_resource = nullptr;
+
+		struct LocalFrameScope
+		{
+			LocalFrameScope(ContextImplement* owner, Implement::FrameMemoryResource* resource) noexcept
+			{
+				local_frame_owner = owner;
+				local_frame_resource = resource;
+			}
+			~LocalFrameScope()
+			{
+				local_frame_owner = nullptr;
+				local_frame_resource = nullptr;
+			}
+		};
+	}
+
 	namespace Exception
 	{
 		const char* MultiExceptions::what() const noexcept
@@ -16,9 +36,13 @@ namespace Noodles
 		size_t platform_thread_count = platform_info::instance().cpu_count() * 2 + 2;
 		size_t reserved = (m_thread_reserved > platform_thread_count) ? 0 : (platform_thread_count - m_thread_reserved);
 		std::vector<std::thread> mulity_thread(reserved);
+		m_frame_resources.clear();
+		for (size_t i = 0; i < reserved + 1; ++i)
+			m_frame_resources.push_back(std::make_unique<Implement::FrameMemoryResource>(allocator));
+		LocalFrameScope scope(this, m_frame_resources[0].get());
 		m_available = true;
-		for (auto& ite : mulity_thread)
-			ite = std::thread(&append_execute_function, this);
+		for (size_t i = 0; i < reserved; ++i)
+			mulity_thread[i] = std::thread(&append_execute_function, this, m_frame_resources[i + 1].get());
 		auto last_tick = std::chrono::system_clock::now();
 		auto target_duration = m_target_duration;
 		m_last_duration = target_duration;
@@ -29,6 +53,7 @@ namespace Noodles
 				bool Component = component_pool.update();
 				bool GobalComponent = gobal_component_pool.update();
 				event_pool.update();
+				allocator.decay(std::chrono::steady_clock::now());
 				{
 					std::lock_guard lg(component_pool.read_mutex());
 					std::lock_guard lg2(gobal_component_pool.read_mutex());
@@ -36,8 +61,11 @@ namespace Noodles
 					if (system_pool.update(Component, GobalComponent, component_pool, gobal_component_pool))
 					{
 						system_pool.asynchro_temporary_system(this);
-						while (system_pool.asynchro_apply_system(this) != Implement::SystemPool::ApplyResult::AllDone)
-							std::this_thread::yield();
+						for (auto result = system_pool.asynchro_apply_system(this); result != Implement::SystemPool::ApplyResult::AllDone; result = system_pool.asynchro_apply_system(this))
+						{
+							if (result != Implement::SystemPool::ApplyResult::Applied && !component_pool.help_update())
+								std::this_thread::yield();
+						}
 
 						if (mulity_thread.empty())
 							while (apply_asynchronous_work());
@@ -51,6 +79,7 @@ namespace Noodles
 						}
 						m_last_duration = std::chrono::duration_cast<std::chrono::milliseconds>(current_tick - last_tick);
 						last_tick = current_tick;
+						++m_frame_count;
 					}
 					else
 						m_available = false;
@@ -75,6 +104,7 @@ namespace Noodles
 		event_pool.clean_all();
 		gobal_component_pool.clean_all();
 		component_pool.clean_all();
+		m_frame_resources.clear();
 
 		{
 			std::lock_guard lg(m_exception_mutex);
@@ -119,7 +149,7 @@ namespace Noodles
 	}
 
 	ContextImplement::ContextImplement() noexcept : m_available(false), m_thread_reserved(0), m_target_duration(duration_ms{ 0 }), m_last_duration(duration_ms{ 0 }),
-		allocator(20), component_pool(allocator), gobal_component_pool(), event_pool(allocator), system_pool()
+		allocator(), component_pool(allocator), gobal_component_pool(), event_pool(allocator), system_pool(), m_frame_count(0)
 	{
 
 	}
@@ -129,14 +159,16 @@ namespace Noodles
 		m_available = false;
 	}
 
-	void ContextImplement::append_execute_function(ContextImplement* con) noexcept
+	void ContextImplement::append_execute_function(ContextImplement* con, Implement::FrameMemoryResource* resource) noexcept
 	{
+		LocalFrameScope scope(con, resource);
 		try {
 			while (con->m_available)
 			{
 				Implement::SystemPool::ApplyResult result = con->system_pool.asynchro_apply_system(con, false);
-				if (result != Implement::SystemPool::ApplyResult::Applied)
+				if (result != Implement::SystemPool::ApplyResult::Applied && !con->component_pool.help_update())
 				{
+					con->allocator.trim_thread_cache();
 					con->apply_asynchronous_work();
 					std::this_thread::yield();
 					std::this_thread::sleep_for(Noodles::duration_ms{ 1 });
@@ -155,7 +187,16 @@ namespace Noodles
 	ContextImplement::operator Implement::GobalComponentPoolInterface* () { return &gobal_component_pool; }
 	ContextImplement::operator Implement::EventPoolInterface* () { return &event_pool; }
 	ContextImplement::operator Implement::SystemPoolInterface* () { return &system_pool; }
-	Implement::EntityInterfacePtr ContextImplement::create_entity_imp() { return Implement::EntityImp::create_one(); }
+
+	std::pmr::memory_resource* ContextImplement::frame_allocator() noexcept
+	{
+		if (local_frame_owner == this && local_frame_resource != nullptr)
+		{
+			local_frame_resource->update(m_frame_count);
+			return local_frame_resource;
+		}
+		return std::pmr::get_default_resource();
+	}
 
 	float ContextImplement::duration_s() const noexcept { 
 		duration_ms tem = m_last_duration;
@@ -1,24 +1,150 @@
 #include "memory.h"
 #include "component_pool.h"
+#include "platform.h"
+#include <algorithm>
 namespace Noodles::Implement
 {
 
 	constexpr size_t memory_page_space = 2048;
 	constexpr size_t memory_flag = 0x12345678;
+	constexpr size_t cache_space = 1024 * 64;
+	constexpr size_t arena_region_space = virtual_memory::huge_page_size;
+	constexpr size_t arena_max_idle_region = 4;
+	// classes below linear_class_space grow by memory_page_space, the rest grow geometrically with 4 steps per doubling.
+	constexpr size_t linear_class_count = 8;
+	constexpr size_t linear_class_space = memory_page_space * linear_class_count;
+	constexpr size_t geometric_class_step = 4;
+	// pages larger than this are mapped directly.
+	constexpr size_t max_class_space = virtual_memory::huge_page_size;
+	constexpr size_t max_arena_class_space = arena_region_space / 8;
+	constexpr size_t max_large_storage = 2;
+
+	constexpr size_t class_space(size_t index) noexcept
+	{
+		if (index < linear_class_count)
+			return (index + 1) * memory_page_space;
+		index -= linear_class_count;
+		size_t base = linear_class_space << (index / geometric_class_step);
+		return base + (base / geometric_class_step) * (index % geometric_class_step + 1);
+	}
+
+	constexpr size_t class_index(size_t space) noexcept
+	{
+		assert(space != 0 && space <= max_class_space);
+		if (space <= linear_class_space)
+			return (space - 1) / memory_page_space;
+		size_t base = linear_class_space;
+		size_t index = linear_class_count;
+		while (space > base * 2)
+		{
+			base *= 2;
+			index += geometric_class_step;
+		}
+		size_t step = base / geometric_class_step;
+		return index + (space - base + step - 1) / step - 1;
+	}
 
 	struct MemoryPageHead
 	{
 		MemoryPageAllocator* owner;
 		size_t index;
 		size_t flag;
+		MemoryPageAllocator::ArenaRegion* region;
+		size_t space;
 		~MemoryPageHead() = default;
 	};
 
-	MemoryPageAllocator::MemoryPageAllocator(size_t storage_page_count) noexcept
-		: m_require_storage(storage_page_count)
+	// a mapped region which is carved into pages of one size class.
+	struct MemoryPageAllocator::ArenaRegion
+	{
+		std::byte* start = nullptr;
+		size_t index = 0;
+		size_t page_count = 0;
+		size_t bump = 0;
+		size_t used = 0;
+		// mapped from the explicit huge page pool, it may not be reset
+		bool large_page = false;
+		RawPageHead* free = nullptr;
+		ArenaRegion* front = nullptr;
+		ArenaRegion* next = nullptr;
+	};
+
+	// pages kept by one thread for one allocator, only touched by its own thread until detached.
+	struct MemoryPageAllocator::ThreadCache
+	{
+		struct Bin
+		{
+			RawPageHead* head = nullptr;
+			size_t count = 0;
+			// lowest count since the last trim, these pages were not used during the decay period
+			size_t low = 0;
+		};
+
+		std::array<Bin, page_class_count> bins;
+		// decay epoch of the last trim, only touched by the owner thread
+		size_t epoch = 0;
+		std::atomic_bool detached = false;
+		std::shared_ptr<std::atomic_size_t> detached_count;
+		std::atomic<uint64_t> hit = 0;
+		std::atomic<uint64_t> miss = 0;
+		std::atomic<uint64_t> refill = 0;
+		std::atomic<uint64_t> flush = 0;
+
+		void add_ref() const noexcept { m_ref.fetch_add(1, std::memory_order_relaxed); }
+		void sub_ref() const noexcept { if (m_ref.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this; }
+
+		// called by the owner thread when it exits
+		void detach() noexcept
+		{
+			detached_count->fetch_add(1, std::memory_order_relaxed);
+			detached.store(true, std::memory_order_release);
+		}
+
+		static void increase(std::atomic<uint64_t>& counter) noexcept
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+
+		// pages larger than cache_space skip the thread cache.
+		static size_t capacity(size_t index) noexcept
+		{
+			size_t count = cache_space / class_space(index);
+			return (count == 1) ? 2 : count;
+		}
+
+	private:
+		mutable std::atomic_size_t m_ref = 0;
+	};
+
+	namespace
+	{
+		std::atomic_size_t allocator_id_count = 1;
+
+		// one cache for each allocator the thread uses, the last used one is checked first
+		struct LocalCacheHolder
+		{
+			std::vector<std::tuple<size_t, Potato::Tool::intrusive_ptr<MemoryPageAllocator::ThreadCache>>> caches;
+			size_t last = 0;
+			~LocalCacheHolder()
+			{
+				for (auto& [id, cache] : caches)
+					if (!cache->detached.load(std::memory_order_relaxed))
+						cache->detach();
+			}
+		};
+
+		thread_local LocalCacheHolder local_holder;
+	}
+
+	MemoryPageAllocator::MemoryPageAllocator(MemoryDecayPolicy policy) noexcept
+		: m_policy(policy), m_decay_start(std::chrono::steady_clock::now()), m_id(allocator_id_count++), m_detached_count(std::make_shared<std::atomic_size_t>(0))
 	{
 		for (auto& ite : m_pages)
 			ite = { nullptr, 0 };
+		for (auto& ite : m_idle_pages)
+			ite = 0;
+		for (auto& ite : m_arena_partial)
+			ite = nullptr;
 	}
 
 	size_t MemoryPageAllocator::reserved_size() noexcept
@@ -28,71 +154,674 @@ namespace Noodles::Implement
 
 	std::tuple<size_t, size_t> MemoryPageAllocator::pre_calculte_size(size_t target_size) noexcept
 	{
+		static_assert(class_space(page_class_count - 1) == max_class_space);
 		target_size += MemoryPageAllocator::reserved_size();
-		size_t index = target_size / memory_page_space;
-		if (target_size % memory_page_space == 0)
-			index -= 1;
-		return { (index + 1) * memory_page_space - MemoryPageAllocator::reserved_size(), index };
+		if (target_size > max_class_space)
+		{
+			size_t space = (target_size + virtual_memory::huge_page_size - 1) / virtual_memory::huge_page_size * virtual_memory::huge_page_size;
+			return { space - MemoryPageAllocator::reserved_size(), large_page_index };
+		}
+		size_t index = class_index(target_size);
+		return { class_space(index) - MemoryPageAllocator::reserved_size(), index };
 	}
 
+	size_t MemoryPageAllocator::storage_count(size_t index, size_t watermark) const noexcept
+	{
+		size_t space = class_space(index);
+		if (space <= cache_space || watermark == 0)
+			return watermark;
+		size_t count = watermark * cache_space / space;
+		return (count == 0) ? 1 : count;
+	}
+
+	void MemoryPageAllocator::take_from_pool(size_t index) noexcept
+	{
+		size_t count = std::get<1>(m_pages[index]);
+		if (m_idle_pages[index] > count)
+			m_idle_pages[index] = count;
+	}
+
+	void MemoryPageAllocator::set_decay_policy(const MemoryDecayPolicy& policy) noexcept
+	{
+		std::lock_guard lg(m_page_mutex);
+		m_policy = policy;
+	}
+
+	size_t MemoryPageAllocator::decay(std::chrono::steady_clock::time_point now) noexcept
+	{
+		// pages of exited threads go back to the pool before it is decayed
+		collect_detached_cache();
+		std::lock_guard lg(m_page_mutex);
+		++m_decay_tick_count;
+		bool tick_reach = (m_policy.decay_tick != 0 && m_decay_tick_count >= m_policy.decay_tick);
+		bool time_reach = (m_policy.decay_time.count() != 0 && now - m_decay_start >= m_policy.decay_time);
+		if (!tick_reach && !time_reach)
+			return 0;
+		m_decay_tick_count = 0;
+		m_decay_start = now;
+		m_decay_epoch.fetch_add(1, std::memory_order_relaxed);
+		size_t released = 0;
+		for (size_t index = 0; index < page_class_count; ++index)
+		{
+			auto& [head, count] = m_pages[index];
+			size_t low = storage_count(index, m_policy.low_watermark);
+			size_t idle = m_idle_pages[index];
+			size_t release_count = (count > low) ? std::min(idle, count - low) : 0;
+			for (size_t i = 0; i < release_count; ++i)
+			{
+				auto cur = head;
+				head = head->m_next_page;
+				--count;
+				size_t returned = destroy_page(cur, index);
+				if (returned == 0)
+					m_decay_retained_bytes += class_space(index);
+				released += returned;
+			}
+			m_idle_pages[index] = count;
+		}
+		size_t large_release = std::min(m_large_idle_pages, m_large_pages.size());
+		for (size_t i = 0; i < large_release; ++i)
+		{
+			auto [buffer, space] = *m_large_pages.begin();
+			m_large_pages.erase(m_large_pages.begin());
+			virtual_memory::release(buffer, space);
+			m_large_mapped_bytes -= space;
+			released += space;
+		}
+		m_large_idle_pages = m_large_pages.size();
+		m_decay_released_bytes += released;
+		return released;
+	}
 
 	MemoryPageAllocator::~MemoryPageAllocator()
 	{
+		{
+			std::lock_guard lg(m_cache_mutex);
+			for (auto& ite : m_caches)
+			{
+				// threads still holding it drop it at their next lookup
+				ite->detached.store(true, std::memory_order_release);
+				for (size_t index = 0; index < page_class_count; ++index)
+				{
+					auto& bin = ite->bins[index];
+					while (bin.head != nullptr)
+					{
+						auto cur = bin.head;
+						bin.head = bin.head->m_next_page;
+						if (cur->region == nullptr)
+						{
+							cur->~RawPageHead();
+							delete[] reinterpret_cast<std::byte*>(cur);
+						}
+					}
+					bin.count = 0;
+				}
+			}
+			m_caches.clear();
+		}
+		{
+			std::lock_guard lg(m_page_mutex);
+			for (auto ite : m_pages)
+			{
+				auto [head, index] = ite;
+				while (head != nullptr)
+				{
+					auto cur = head;
+					head = head->m_next_page;
+					if (cur->region == nullptr)
+					{
+						cur->~RawPageHead();
+						delete[] reinterpret_cast<std::byte*>(cur);
+					}
+				}
+			}
+			for (auto [buffer, space] : m_large_pages)
+				virtual_memory::release(buffer, space);
+			m_large_pages.clear();
+		}
+		std::lock_guard lg(m_arena_mutex);
+		for (auto ite : m_arena_regions)
+		{
+			virtual_memory::release(ite->start, arena_region_space);
+			delete ite;
+		}
+		m_arena_regions.clear();
+		m_arena_idle.clear();
+	}
+
+	auto MemoryPageAllocator::local_cache() -> ThreadCache&
+	{
+		auto& cache = find_local_cache();
+		if (cache.epoch != m_decay_epoch.load(std::memory_order_relaxed))
+			trim(cache);
+		return cache;
+	}
+
+	void MemoryPageAllocator::trim_thread_cache() noexcept
+	{
+		for (auto& [id, cache] : local_holder.caches)
+		{
+			if (id == m_id)
+			{
+				if (!cache->detached.load(std::memory_order_acquire) && cache->epoch != m_decay_epoch.load(std::memory_order_relaxed))
+					trim(*cache);
+				return;
+			}
+		}
+	}
+
+	void MemoryPageAllocator::trim(ThreadCache& cache) noexcept
+	{
+		cache.epoch = m_decay_epoch.load(std::memory_order_relaxed);
+		bool idle = false;
+		for (auto& bin : cache.bins)
+			idle = idle || bin.low != 0;
+		if (idle)
+		{
+			std::lock_guard lg(m_page_mutex);
+			size_t released = 0;
+			for (size_t index = 0; index < page_class_count; ++index)
+			{
+				auto& bin = cache.bins[index];
+				for (size_t i = 0; i < bin.low && bin.head != nullptr; ++i)
+				{
+					auto cur = bin.head;
+					bin.head = bin.head->m_next_page;
+					--bin.count;
+					size_t returned = destroy_page(cur, index);
+					if (returned == 0)
+						m_decay_retained_bytes += class_space(index);
+					released += returned;
+				}
+			}
+			m_decay_released_bytes += released;
+		}
+		// pages left now start the next period
+		for (auto& bin : cache.bins)
+			bin.low = bin.count;
+	}
+
+	auto MemoryPageAllocator::find_local_cache() -> ThreadCache&
+	{
+		auto& holder = local_holder;
+		if (holder.last < holder.caches.size() && std::get<0>(holder.caches[holder.last]) == m_id)
+			return *std::get<1>(holder.caches[holder.last]);
+		// caches of destroyed allocators
+		holder.caches.erase(std::remove_if(holder.caches.begin(), holder.caches.end(), [](auto& ite) {
+			return std::get<1>(ite)->detached.load(std::memory_order_acquire);
+		}), holder.caches.end());
+		auto find_result = std::find_if(holder.caches.begin(), holder.caches.end(), [this](auto& ite) { return std::get<0>(ite) == m_id; });
+		if (find_result == holder.caches.end())
+		{
+			ThreadCachePtr cache = new ThreadCache{};
+			cache->detached_count = m_detached_count;
+			cache->epoch = m_decay_epoch.load(std::memory_order_relaxed);
+			{
+				std::lock_guard lg(m_cache_mutex);
+				m_caches.push_back(cache);
+			}
+			collect_detached_cache();
+			holder.caches.emplace_back(m_id, std::move(cache));
+			find_result = holder.caches.end() - 1;
+		}
+		holder.last = find_result - holder.caches.begin();
+		return *std::get<1>(*find_result);
+	}
+
+	void MemoryPageAllocator::collect_detached_cache() noexcept
+	{
+		if (m_detached_count->load(std::memory_order_relaxed) == 0)
+			return;
+		std::lock_guard lg(m_cache_mutex);
+		for (auto ite = m_caches.begin(); ite != m_caches.end();)
+		{
+			if ((*ite)->detached.load(std::memory_order_acquire))
+			{
+				m_detached_count->fetch_sub(1, std::memory_order_relaxed);
+				auto& cache = **ite;
+				for (size_t index = 0; index < page_class_count; ++index)
+					flush(cache, index, cache.bins[index].count);
+				m_retired_statistics.cache_hit += cache.hit.load(std::memory_order_relaxed);
+				m_retired_statistics.cache_miss += cache.miss.load(std::memory_order_relaxed);
+				m_retired_statistics.cache_refill += cache.refill.load(std::memory_order_relaxed);
+				m_retired_statistics.cache_flush += cache.flush.load(std::memory_order_relaxed);
+				ite = m_caches.erase(ite);
+			}
+			else
+				++ite;
+		}
+	}
+
+	void MemoryPageAllocator::refill(ThreadCache& cache, size_t index) noexcept
+	{
+		auto& bin = cache.bins[index];
+		assert(bin.head == nullptr && bin.count == 0);
 		std::lock_guard lg(m_page_mutex);
-		for (auto ite : m_pages)
+		auto& [head, count] = m_pages[index];
+		if (count != 0)
 		{
-			auto [head, index] = ite;
-			while (head != nullptr)
+			size_t batch = ThreadCache::capacity(index) / 2;
+			batch = (batch == 0) ? 1 : batch;
+			while (head != nullptr && bin.count < batch)
 			{
 				auto cur = head;
 				head = head->m_next_page;
-				cur->~RawPageHead();
-				delete[] reinterpret_cast<std::byte*>(cur);
+				--count;
+				cur->m_next_page = bin.head;
+				bin.head = cur;
+				++bin.count;
 			}
+			ThreadCache::increase(cache.refill);
+			take_from_pool(index);
+		}
+	}
+
+	void MemoryPageAllocator::flush(ThreadCache& cache, size_t index, size_t flush_count) noexcept
+	{
+		auto& bin = cache.bins[index];
+		if (flush_count == 0)
+			return;
+		std::lock_guard lg(m_page_mutex);
+		for (size_t i = 0; i < flush_count && bin.head != nullptr; ++i)
+		{
+			auto cur = bin.head;
+			bin.head = bin.head->m_next_page;
+			--bin.count;
+			release_to_pool(cur, index);
+		}
+		bin.low = std::min(bin.low, bin.count);
+		ThreadCache::increase(cache.flush);
+	}
+
+	void MemoryPageAllocator::release_to_pool(RawPageHead* input, size_t index) noexcept
+	{
+		assert(m_pages.size() > index);
+		auto& [old_head, old_index] = m_pages[index];
+		if (old_index >= storage_count(index, m_policy.high_watermark))
+			destroy_page(input, index);
+		else {
+			input->m_next_page = old_head;
+			old_head = input;
+			++old_index;
 		}
 	}
 
 	std::tuple<std::byte*, size_t> MemoryPageAllocator::allocate(size_t target_sapce)
 	{
 		auto [space, index] = pre_calculte_size(target_sapce);
-		std::lock_guard lg(m_page_mutex);
+		if (index == large_page_index)
+			return allocate_large(space);
 		assert(m_pages.size() >= index + 1);
-		auto& [head, count] = m_pages[index];
+		RawPageHead* next = nullptr;
+		if (ThreadCache::capacity(index) != 0)
+		{
+			auto& cache = local_cache();
+			auto& bin = cache.bins[index];
+			if (bin.head != nullptr)
+				ThreadCache::increase(cache.hit);
+			else {
+				ThreadCache::increase(cache.miss);
+				refill(cache, index);
+			}
+			if (bin.head != nullptr)
+			{
+				next = bin.head;
+				bin.head = next->m_next_page;
+				--bin.count;
+				bin.low = std::min(bin.low, bin.count);
+			}
+		}
+		else {
+			std::lock_guard lg(m_page_mutex);
+			auto& [head, count] = m_pages[index];
+			if (head != nullptr)
+			{
+				next = head;
+				head = head->m_next_page;
+				--count;
+				take_from_pool(index);
+			}
+		}
 		std::byte* buffer = nullptr;
-		if (count == 0)
-			buffer = new std::byte[(index + 1) * memory_page_space];
+		ArenaRegion* region = nullptr;
+		if (next == nullptr)
+			std::tie(buffer, region) = create_page(index);
 		else {
-			assert(head != nullptr);
-			auto next = head;
-			head = head->m_next_page;
+			region = next->region;
 			next->~RawPageHead();
 			buffer = reinterpret_cast<std::byte*>(next);
-			--count;
 		}
-		auto ptr = new (buffer) MemoryPageHead{this, index, memory_flag };
+		auto ptr = new (buffer) MemoryPageHead{this, index, memory_flag, region, space };
+		return { buffer + sizeof(MemoryPageHead), space };
+	}
+
+	std::tuple<std::byte*, size_t> MemoryPageAllocator::allocate_large(size_t space)
+	{
+		size_t total_space = space + sizeof(MemoryPageHead);
+		std::byte* buffer = nullptr;
+		{
+			std::lock_guard lg(m_page_mutex);
+			for (auto ite = m_large_pages.begin(); ite != m_large_pages.end(); ++ite)
+			{
+				if (std::get<1>(*ite) == total_space)
+				{
+					buffer = std::get<0>(*ite);
+					m_large_pages.erase(ite);
+					m_large_idle_pages = std::min(m_large_idle_pages, m_large_pages.size());
+					break;
+				}
+			}
+		}
+		if (buffer == nullptr)
+		{
+			MemoryPageSource source = m_source.load(std::memory_order_relaxed);
+			HugePageMode mode = HugePageMode::None;
+			if (source == MemoryPageSource::ArenaTransparentHugePage)
+				mode = HugePageMode::Transparent;
+			else if (source == MemoryPageSource::ArenaExplicitHugePage)
+				mode = HugePageMode::Explicit;
+			buffer = virtual_memory::allocate(total_space, mode);
+			if (buffer == nullptr)
+				throw std::bad_alloc{};
+			m_large_mapped_bytes += total_space;
+		}
+		new (buffer) MemoryPageHead{ this, large_page_index, memory_flag, nullptr, space };
 		return { buffer + sizeof(MemoryPageHead), space };
 	}
 
+	void MemoryPageAllocator::release_large(std::byte* buffer, size_t space) noexcept
+	{
+		size_t total_space = space + sizeof(MemoryPageHead);
+		std::lock_guard lg(m_page_mutex);
+		if (m_large_pages.size() < max_large_storage)
+			m_large_pages.emplace_back(buffer, total_space);
+		else {
+			virtual_memory::release(buffer, total_space);
+			m_large_mapped_bytes -= total_space;
+		}
+	}
+
 	void MemoryPageAllocator::release(std::byte* input) noexcept
 	{
 		assert(input != nullptr);
 		MemoryPageHead* buffer = reinterpret_cast<MemoryPageHead*>(input) - 1;
 		assert(buffer->flag == memory_flag);
 		size_t index = buffer->index;
-		std::lock_guard lg(buffer->owner->m_page_mutex);
-		assert(buffer->owner->m_pages.size() > index);
-		auto& [old_head, old_index] = buffer->owner->m_pages[index];
-		if (old_index >= buffer->owner->m_require_storage)
+		MemoryPageAllocator* owner = buffer->owner;
+		ArenaRegion* region = buffer->region;
+		size_t space = buffer->space;
+		buffer->~MemoryPageHead();
+		if (index == large_page_index)
 		{
-			buffer->~MemoryPageHead();
-			delete[](buffer);
+			owner->release_large(reinterpret_cast<std::byte*>(buffer), space);
+			return;
+		}
+		assert(owner->m_pages.size() > index);
+		RawPageHead* head = new (buffer) RawPageHead{};
+		head->region = region;
+		ThreadCache* cache = nullptr;
+		if (ThreadCache::capacity(index) != 0)
+		{
+			try {
+				cache = &owner->local_cache();
+			}
+			catch (...) {}
+		}
+		if (cache != nullptr)
+		{
+			auto& bin = cache->bins[index];
+			head->m_next_page = bin.head;
+			bin.head = head;
+			++bin.count;
+			size_t capacity = ThreadCache::capacity(index);
+			if (bin.count > capacity)
+			{
+				owner->flush(*cache, index, bin.count - capacity / 2);
+				owner->collect_detached_cache();
+			}
 		}
 		else {
-			buffer->~MemoryPageHead();
-			RawPageHead* head = new (buffer) RawPageHead{};
-			head->m_next_page = old_head;
-			old_head = head;
-			++old_index;
+			std::lock_guard lg(owner->m_page_mutex);
+			owner->release_to_pool(head, index);
+		}
+	}
+
+	auto MemoryPageAllocator::statistics() const noexcept -> Statistics
+	{
+		Statistics result;
+		{
+			std::lock_guard lg(m_cache_mutex);
+			result = m_retired_statistics;
+			for (auto& ite : m_caches)
+			{
+				result.cache_hit += ite->hit.load(std::memory_order_relaxed);
+				result.cache_miss += ite->miss.load(std::memory_order_relaxed);
+				result.cache_refill += ite->refill.load(std::memory_order_relaxed);
+				result.cache_flush += ite->flush.load(std::memory_order_relaxed);
+			}
+		}
+		{
+			std::lock_guard lg(m_page_mutex);
+			result.large_page_mapped_bytes = m_large_mapped_bytes;
+			result.decay_released_bytes = m_decay_released_bytes;
+			result.decay_retained_bytes = m_decay_retained_bytes;
+		}
+		std::lock_guard lg(m_arena_mutex);
+		result.arena_region_count = m_arena_regions.size();
+		result.arena_mapped_bytes = m_arena_regions.size() * arena_region_space;
+		result.arena_reset_bytes = m_arena_reset_bytes;
+		return result;
+	}
+
+	void MemoryPageAllocator::remove_region_from_list(ArenaRegion* region) noexcept
+	{
+		auto front = region->front;
+		auto next = region->next;
+		if (front != nullptr)
+			front->next = next;
+		else {
+			assert(m_arena_partial[region->index] == region);
+			m_arena_partial[region->index] = next;
+		}
+		if (next != nullptr)
+			next->front = front;
+		region->front = nullptr;
+		region->next = nullptr;
+	}
+
+	void MemoryPageAllocator::insert_region_to_list(ArenaRegion* region) noexcept
+	{
+		auto& head = m_arena_partial[region->index];
+		region->front = nullptr;
+		region->next = head;
+		if (head != nullptr)
+			head->front = region;
+		head = region;
+	}
+
+	auto MemoryPageAllocator::create_page(size_t index) -> std::tuple<std::byte*, ArenaRegion*>
+	{
+		size_t page_space = class_space(index);
+		MemoryPageSource source = m_source.load(std::memory_order_relaxed);
+		if (source != MemoryPageSource::Heap && page_space <= max_arena_class_space)
+		{
+			std::lock_guard lg(m_arena_mutex);
+			ArenaRegion* region = m_arena_partial[index];
+			if (region == nullptr)
+			{
+				if (!m_arena_idle.empty())
+				{
+					region = *m_arena_idle.rbegin();
+					m_arena_idle.pop_back();
+				}
+				else {
+					HugePageMode mode = HugePageMode::None;
+					if (source == MemoryPageSource::ArenaTransparentHugePage)
+						mode = HugePageMode::Transparent;
+					else if (source == MemoryPageSource::ArenaExplicitHugePage)
+						mode = HugePageMode::Explicit;
+					bool large_page = false;
+					std::byte* start = virtual_memory::allocate(arena_region_space, mode, &large_page);
+					if (start != nullptr)
+					{
+						region = new ArenaRegion{};
+						region->start = start;
+						region->large_page = large_page;
+						m_arena_regions.push_back(region);
+					}
+				}
+				if (region != nullptr)
+				{
+					region->index = index;
+					region->page_count = arena_region_space / page_space;
+					region->bump = 0;
+					region->used = 0;
+					region->free = nullptr;
+					insert_region_to_list(region);
+				}
+			}
+			if (region != nullptr)
+			{
+				std::byte* buffer = nullptr;
+				if (region->free != nullptr)
+				{
+					auto cur = region->free;
+					region->free = cur->m_next_page;
+					cur->~RawPageHead();
+					buffer = reinterpret_cast<std::byte*>(cur);
+				}
+				else {
+					assert(region->bump < region->page_count);
+					buffer = region->start + region->bump * page_space;
+					++region->bump;
+				}
+				++region->used;
+				if (region->used == region->page_count)
+					remove_region_from_list(region);
+				return { buffer, region };
+			}
+		}
+		return { new std::byte[page_space], nullptr };
+	}
+
+	size_t MemoryPageAllocator::destroy_page(RawPageHead* head, size_t index) noexcept
+	{
+		ArenaRegion* region = head->region;
+		if (region == nullptr)
+		{
+			head->~RawPageHead();
+			delete[] reinterpret_cast<std::byte*>(head);
+			return class_space(index);
+		}
+		else {
+			std::lock_guard lg(m_arena_mutex);
+			assert(region->index == index && region->used > 0);
+			bool was_full = (region->used == region->page_count);
+			head->m_next_page = region->free;
+			region->free = head;
+			--region->used;
+			if (region->used == 0)
+			{
+				if (!was_full)
+					remove_region_from_list(region);
+				region->free = nullptr;
+				region->bump = 0;
+				// large page regions can not give their memory back without being released
+				if (m_arena_idle.size() < arena_max_idle_region && !region->large_page && virtual_memory::reset(region->start, arena_region_space))
+					m_arena_idle.push_back(region);
+				else {
+					virtual_memory::release(region->start, arena_region_space);
+					m_arena_regions.erase(std::find(m_arena_regions.begin(), m_arena_regions.end(), region));
+					delete region;
+				}
+				m_arena_reset_bytes += arena_region_space;
+				return arena_region_space;
+			}
+			else if (was_full)
+				insert_region_to_list(region);
+			return 0;
+		}
+	}
+
+	constexpr size_t frame_chunk_space = cache_space;
+
+	FrameMemoryResource::~FrameMemoryResource()
+	{
+		reset();
+		while (m_chunks != nullptr)
+		{
+			auto cur = m_chunks;
+			m_chunks = m_chunks->next;
+			cur->~Chunk();
+			MemoryPageAllocator::release(reinterpret_cast<std::byte*>(cur));
+		}
+		m_current = nullptr;
+	}
+
+	void FrameMemoryResource::reset() noexcept
+	{
+		while (m_oversized != nullptr)
+		{
+			auto cur = m_oversized;
+			m_oversized = m_oversized->next;
+			cur->~Chunk();
+			MemoryPageAllocator::release(reinterpret_cast<std::byte*>(cur));
+		}
+		m_current = m_chunks;
+		if (m_current != nullptr)
+		{
+			m_last = reinterpret_cast<std::byte*>(m_current + 1);
+			m_last_space = m_current->space;
+		}
+		else {
+			m_last = nullptr;
+			m_last_space = 0;
+		}
+	}
+
+	auto FrameMemoryResource::allocate_chunk(size_t space) -> Chunk*
+	{
+		auto [buffer, buffer_space] = m_allocator.allocate(space + sizeof(Chunk));
+		return new (buffer) Chunk{ nullptr, buffer_space - sizeof(Chunk) };
+	}
+
+	void* FrameMemoryResource::do_allocate(size_t bytes, size_t align)
+	{
+		void* last = m_last;
+		if (m_last != nullptr && std::align(align, bytes, last, m_last_space) != nullptr)
+		{
+			m_last = static_cast<std::byte*>(last) + bytes;
+			m_last_space -= bytes;
+			return last;
+		}
+		size_t require = bytes + align;
+		if (require > frame_chunk_space / 4)
+		{
+			Chunk* chunk = allocate_chunk(require);
+			chunk->next = m_oversized;
+			m_oversized = chunk;
+			void* start = chunk + 1;
+			size_t space = chunk->space;
+			void* result = std::align(align, bytes, start, space);
+			assert(result != nullptr);
+			return result;
+		}
+		if (m_current != nullptr && m_current->next != nullptr)
+			m_current = m_current->next;
+		else {
+			Chunk* chunk = allocate_chunk(frame_chunk_space - MemoryPageAllocator::reserved_size() - sizeof(Chunk));
+			if (m_current != nullptr)
+				m_current->next = chunk;
+			else
+				m_chunks = chunk;
+			m_current = chunk;
 		}
+		last = m_current + 1;
+		m_last_space = m_current->space;
+		void* result = std::align(align, bytes, last, m_last_space);
+		assert(result != nullptr);
+		m_last = static_cast<std::byte*>(result) + bytes;
+		m_last_space -= bytes;
+		return result;
 	}
-}
\ No newline at end of file
+}
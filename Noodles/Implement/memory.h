@@ -2,28 +2,173 @@
 #include <tuple>
 #include <mutex>
 #include <array>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <memory_resource>
+#include "../../Potato/smart_pointer.h"
 namespace Noodles::Implement
 {
-	
+
+	enum class MemoryPageSource : uint8_t
+	{
+		// every page is a separated heap allocation
+		Heap = 0,
+		// pages are carved out of large mapped regions, each region serves one size class
+		Arena = 1,
+		// Arena with regions hinted to be backed by transparent huge pages
+		ArenaTransparentHugePage = 2,
+		// Arena with regions mapped from the explicit huge page pool, falls back to transparent huge pages
+		ArenaExplicitHugePage = 3,
+	};
+
+	// watermarks count pages of the smallest classes, they shrink for classes larger than 64KB
+	struct MemoryDecayPolicy
+	{
+		// pages released to the pool beyond this are freed at once
+		size_t high_watermark = 20;
+		// pages kept by the pool no matter how long they stay unused
+		size_t low_watermark = 4;
+		// idle pages are released after this many ticks or this much time, 0 disables the condition
+		size_t decay_tick = 120;
+		std::chrono::milliseconds decay_time = std::chrono::milliseconds{ 2000 };
+	};
+
 	struct MemoryPageAllocator
 	{
 
-		MemoryPageAllocator(size_t storage_page_count = 4) noexcept;
+		struct Statistics
+		{
+			// allocate requests served by the calling thread's cache
+			uint64_t cache_hit = 0;
+			// allocate requests which had to go to the shared pool
+			uint64_t cache_miss = 0;
+			// batched transfers between thread caches and the shared pool
+			uint64_t cache_refill = 0;
+			uint64_t cache_flush = 0;
+			// regions currently mapped by the arena
+			uint64_t arena_region_count = 0;
+			uint64_t arena_mapped_bytes = 0;
+			// bytes given back to the system from idle regions
+			uint64_t arena_reset_bytes = 0;
+			// bytes mapped for pages larger than the biggest size class, including recycled ones
+			uint64_t large_page_mapped_bytes = 0;
+			// bytes given back to the system by decay, freed heap pages and arena regions which become empty,
+			// idle pages trimmed from thread caches are counted too
+			uint64_t decay_released_bytes = 0;
+			// bytes of idle arena pages released by decay which stay mapped inside their regions
+			uint64_t decay_retained_bytes = 0;
+			float hit_rate() const noexcept {
+				uint64_t total = cache_hit + cache_miss;
+				return total == 0 ? 0.0f : static_cast<float>(cache_hit) / static_cast<float>(total);
+			}
+		};
+
+		struct ThreadCache;
+		struct ArenaRegion;
+
+		MemoryPageAllocator(MemoryDecayPolicy policy = {}) noexcept;
 		~MemoryPageAllocator();
 
 		std::tuple<std::byte*, size_t> allocate(size_t target_sapce);
 		static void release(std::byte* buffer) noexcept;
 		static size_t reserved_size() noexcept;
 		static std::tuple<size_t, size_t> pre_calculte_size(size_t) noexcept;
+		Statistics statistics() const noexcept;
+		// only affects pages created afterward, pages always go back to where they come from
+		void set_page_source(MemoryPageSource source) noexcept { m_source = source; }
+		void set_decay_policy(const MemoryDecayPolicy& policy) noexcept;
+		// called once per tick, releases pages of the shared pool which were not reused during the last period, return the bytes given back to the system,
+		// each thread trims the idle pages of its own cache at its next allocate or release after that
+		size_t decay(std::chrono::steady_clock::time_point now) noexcept;
+		// trims the cache of the calling thread if decay ran since the last trim, for threads which may stay idle
+		void trim_thread_cache() noexcept;
 	private:
+		static constexpr size_t page_class_count = 36;
+		static constexpr size_t large_page_index = page_class_count;
 		struct RawPageHead
 		{
 			size_t flag = 0x23234345;
 			RawPageHead* m_next_page = nullptr;
+			ArenaRegion* region = nullptr;
 			~RawPageHead() = default;
 		};
-		std::mutex m_page_mutex;
-		std::array<std::tuple<RawPageHead*, size_t>, 10> m_pages;
-		uint64_t m_require_storage;
+		using ThreadCachePtr = Potato::Tool::intrusive_ptr<ThreadCache>;
+
+		ThreadCache& local_cache();
+		ThreadCache& find_local_cache();
+		void trim(ThreadCache&) noexcept;
+		void refill(ThreadCache&, size_t index) noexcept;
+		void flush(ThreadCache&, size_t index, size_t count) noexcept;
+		void release_to_pool(RawPageHead* head, size_t index) noexcept;
+		void collect_detached_cache() noexcept;
+		size_t storage_count(size_t index, size_t watermark) const noexcept;
+		void take_from_pool(size_t index) noexcept;
+		std::tuple<std::byte*, size_t> allocate_large(size_t space);
+		void release_large(std::byte* buffer, size_t space) noexcept;
+		std::tuple<std::byte*, ArenaRegion*> create_page(size_t index);
+		// return the bytes given back to the system, 0 if the page stays mapped in its region
+		size_t destroy_page(RawPageHead* head, size_t index) noexcept;
+		void remove_region_from_list(ArenaRegion*) noexcept;
+		void insert_region_to_list(ArenaRegion*) noexcept;
+
+		mutable std::mutex m_page_mutex;
+		std::array<std::tuple<RawPageHead*, size_t>, page_class_count> m_pages;
+		MemoryDecayPolicy m_policy;
+		std::vector<std::tuple<std::byte*, size_t>> m_large_pages;
+		uint64_t m_large_mapped_bytes = 0;
+
+		// lowest pool size of each class since the last decay, these pages were not reused during the period
+		std::array<size_t, page_class_count> m_idle_pages;
+		size_t m_large_idle_pages = 0;
+		size_t m_decay_tick_count = 0;
+		std::chrono::steady_clock::time_point m_decay_start;
+		uint64_t m_decay_released_bytes = 0;
+		uint64_t m_decay_retained_bytes = 0;
+		// bumped each time decay runs, caches trim themselves when they see a new one
+		std::atomic_size_t m_decay_epoch = 0;
+
+		const size_t m_id;
+		mutable std::mutex m_cache_mutex;
+		std::vector<ThreadCachePtr> m_caches;
+		// caches detached by their threads and not collected yet, shared with the caches which may outlive the allocator
+		std::shared_ptr<std::atomic_size_t> m_detached_count;
+		Statistics m_retired_statistics;
+
+		std::atomic<MemoryPageSource> m_source = MemoryPageSource::Heap;
+		mutable std::mutex m_arena_mutex;
+		std::array<ArenaRegion*, page_class_count> m_arena_partial;
+		std::vector<ArenaRegion*> m_arena_idle;
+		std::vector<ArenaRegion*> m_arena_regions;
+		uint64_t m_arena_reset_bytes = 0;
+	};
+
+	// bump allocator owned by one thread, everything allocated is dropped together when the frame changes.
+	struct FrameMemoryResource : std::pmr::memory_resource
+	{
+		FrameMemoryResource(MemoryPageAllocator& allocator) noexcept : m_allocator(allocator) {}
+		~FrameMemoryResource();
+		void update(size_t frame) noexcept { if (frame != m_frame) { m_frame = frame; reset(); } }
+		void reset() noexcept;
+	private:
+		struct Chunk
+		{
+			Chunk* next = nullptr;
+			size_t space = 0;
+		};
+		virtual void* do_allocate(size_t bytes, size_t align) override;
+		virtual void do_deallocate(void*, size_t, size_t) override {}
+		virtual bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+		Chunk* allocate_chunk(size_t space);
+
+		MemoryPageAllocator& m_allocator;
+		size_t m_frame = 0;
+		// chunks are kept between frames, oversized ones are released on reset
+		Chunk* m_chunks = nullptr;
+		Chunk* m_current = nullptr;
+		Chunk* m_oversized = nullptr;
+		std::byte* m_last = nullptr;
+		size_t m_last_space = 0;
 	};
-}
\ No newline at end of file
+}
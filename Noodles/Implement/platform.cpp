@@ -1,6 +1,10 @@
 #include "platform.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 namespace Noodles
 {
+#ifdef _WIN32
 	process_scription& process_scription::instance()
 	{
 		static process_scription ins;
@@ -17,4 +21,115 @@ namespace Noodles
 		static platform_info info;
 		return info;
 	}
-}
\ No newline at end of file
+
+	std::byte* virtual_memory::allocate(size_t size, HugePageMode mode, bool* large_page) noexcept
+	{
+		if (large_page != nullptr)
+			*large_page = false;
+		if (mode == HugePageMode::Explicit)
+		{
+			size_t large_page_size = GetLargePageMinimum();
+			if (large_page_size != 0 && size % large_page_size == 0)
+			{
+				void* result = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+				if (result != nullptr)
+				{
+					if (large_page != nullptr)
+						*large_page = true;
+					return static_cast<std::byte*>(result);
+				}
+			}
+		}
+		// a reservation can not be partly released, so find an aligned address with a larger one and map there,
+		// another thread may take the address in between, try again in that case.
+		for (size_t i = 0; i < 8; ++i)
+		{
+			void* probe = VirtualAlloc(nullptr, size + huge_page_size, MEM_RESERVE, PAGE_NOACCESS);
+			if (probe == nullptr)
+				return nullptr;
+			std::byte* aligned = reinterpret_cast<std::byte*>(
+				(reinterpret_cast<uintptr_t>(probe) + huge_page_size - 1) & ~(uintptr_t(huge_page_size) - 1)
+			);
+			VirtualFree(probe, 0, MEM_RELEASE);
+			void* result = VirtualAlloc(aligned, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+			if (result != nullptr)
+				return static_cast<std::byte*>(result);
+		}
+		return nullptr;
+	}
+
+	void virtual_memory::release(std::byte* address, size_t size) noexcept
+	{
+		VirtualFree(address, 0, MEM_RELEASE);
+	}
+
+	bool virtual_memory::reset(std::byte* address, size_t size) noexcept
+	{
+		// MEM_RESET keeps the content until the pages are reclaimed, decommit instead so that they read as zero,
+		// large pages can not be decommitted
+		if (VirtualFree(address, size, MEM_DECOMMIT) == 0)
+			return false;
+		return VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+	}
+#else
+	platform_info::platform_info()
+	{
+		count = std::thread::hardware_concurrency();
+		count = (count == 0) ? 1 : count;
+	}
+
+	const platform_info& platform_info::instance()
+	{
+		static platform_info info;
+		return info;
+	}
+
+	std::byte* virtual_memory::allocate(size_t size, HugePageMode mode, bool* large_page) noexcept
+	{
+		if (large_page != nullptr)
+			*large_page = false;
+#ifdef MAP_HUGETLB
+		if (mode == HugePageMode::Explicit && size % huge_page_size == 0)
+		{
+			void* result = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (result != MAP_FAILED)
+			{
+				if (large_page != nullptr)
+					*large_page = true;
+				return static_cast<std::byte*>(result);
+			}
+		}
+#endif
+		// over reserve so that the region can be aligned to huge page boundary.
+		size_t reserve_size = size + huge_page_size;
+		void* result = mmap(nullptr, reserve_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (result == MAP_FAILED)
+			return nullptr;
+		std::byte* start = static_cast<std::byte*>(result);
+		std::byte* aligned = reinterpret_cast<std::byte*>(
+			(reinterpret_cast<uintptr_t>(start) + huge_page_size - 1) & ~(uintptr_t(huge_page_size) - 1)
+		);
+		if (aligned != start)
+			munmap(start, aligned - start);
+		std::byte* end = aligned + size;
+		std::byte* reserve_end = start + reserve_size;
+		if (reserve_end != end)
+			munmap(end, reserve_end - end);
+#ifdef MADV_HUGEPAGE
+		if (mode != HugePageMode::None)
+			madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+		return aligned;
+	}
+
+	void virtual_memory::release(std::byte* address, size_t size) noexcept
+	{
+		munmap(address, size);
+	}
+
+	bool virtual_memory::reset(std::byte* address, size_t size) noexcept
+	{
+		return madvise(address, size, MADV_DONTNEED) == 0;
+	}
+#endif
+}
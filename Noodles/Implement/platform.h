@@ -1,7 +1,10 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #ifdef _WIN32
 #include "windows.h"
 #else
+#include <thread>
 #endif //_Win32
 
 namespace Noodles
@@ -21,8 +24,8 @@ namespace Noodles
 	{
 		SYSTEM_INFO  info;
 	};
-	
-	
+
+
 
 	struct platform_info
 	{
@@ -34,5 +37,39 @@ namespace Noodles
 		size_t cpu_count() const noexcept { return static_cast<size_t>(info.dwNumberOfProcessors); }
 	};
 
+#else
+
+	struct platform_info
+	{
+		static const platform_info& instance();
+	public:
+		platform_info();
+		platform_info(const platform_info&) = delete;
+		size_t cpu_count() const noexcept { return count; }
+	private:
+		size_t count;
+	};
+
 #endif // _WIN32
-}
\ No newline at end of file
+
+	enum class HugePageMode : uint8_t
+	{
+		None = 0,
+		// hint the kernel to back the region with transparent huge pages
+		Transparent = 1,
+		// map the region from the explicit huge page pool, falls back to None if unavailable
+		Explicit = 2,
+	};
+
+	struct virtual_memory
+	{
+		static constexpr size_t huge_page_size = 1024 * 1024 * 2;
+		// reserve and commit a readable and writable region, aligned to huge_page_size,
+		// large_page is set if the region is mapped from the explicit huge page pool
+		static std::byte* allocate(size_t size, HugePageMode mode, bool* large_page = nullptr) noexcept;
+		static void release(std::byte* address, size_t size) noexcept;
+		// give physical memory back to the system, the region stay usable and reads as zero on next touch,
+		// false if the system refuses, such as for large pages on windows, then the region should be released
+		static bool reset(std::byte* address, size_t size) noexcept;
+	};
+}
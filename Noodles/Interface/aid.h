@@ -1,23 +1,38 @@
 #pragma once
 #include <map>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <cstring>
 #include "..//..//Potato/smart_pointer.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 namespace Noodles
 {
 
 	using Potato::Tool::intrusive_ptr;
 	using Potato::Tool::observer_ptr;
 
+	// specialize it as std::true_type to keep the component in a sparse set instead of type groups,
+	// adding or removing it never moves the other components of entity
+	template<typename CompT> struct SparseComponent : std::false_type {};
+
 	struct TypeInfo
 	{
 		size_t hash_code;
 		size_t size;
 		size_t align;
 		const char* name;
+		// empty and trivially destructible, such component only lives in the signature of type group
+		bool tag;
+		bool sparse;
 		~TypeInfo() = default;
 		template<typename Type> static const TypeInfo& create() noexcept {
-			static TypeInfo type{ typeid(Type).hash_code(), sizeof(Type), alignof(Type), typeid(Type).name() };
+			static TypeInfo type{ typeid(Type).hash_code(), sizeof(Type), alignof(Type), typeid(Type).name(), std::is_empty_v<Type> && std::is_trivially_destructible_v<Type>, SparseComponent<std::remove_cv_t<Type>>::value };
 			return type;
 		}
+		size_t storage_size() const noexcept { return tag ? 0 : size; }
 		bool operator<(const TypeInfo& r) const noexcept
 		{
 			if (hash_code < r.hash_code)
@@ -85,25 +100,116 @@ namespace Noodles
 
 		struct TypeGroup;
 
-		struct EntityInterface;
+		// index into the entity table, the generation tells a destoried entity from the one reusing its slot
+		struct EntityId
+		{
+			static constexpr uint32_t invalid_index = std::numeric_limits<uint32_t>::max();
+			uint32_t index = invalid_index;
+			uint32_t generation = 0;
+		};
 
+		// nullptr means the type is trivial, moved by memcpy and destructed by nothing
 		struct StorageBlockFunctionPair
 		{
 			void (*destructor)(void*) noexcept = nullptr;
 			void (*mover)(void*, void*) noexcept = nullptr;
+			void destruct(void* data) const noexcept { if (destructor != nullptr) destructor(data); }
+			void move(void* target, void* source, size_t size) const noexcept {
+				if (mover != nullptr)
+					mover(target, source);
+				else if (size != 0)
+					std::memcpy(target, source, size);
+			}
 		};
 
 		struct StorageBlock
 		{
-			const TypeGroup* m_owner = nullptr;
+			TypeGroup* m_owner = nullptr;
 			StorageBlock* front = nullptr;
 			StorageBlock* next = nullptr;
 			size_t available_count = 0;
-			StorageBlockFunctionPair** functions = nullptr;
+			size_t capacity = 0;
+			// one for each column, shared by all blocks of the owner
+			StorageBlockFunctionPair* functions = nullptr;
 			void** datas = nullptr;
-			EntityInterface** entitys = nullptr;
+			// index of the entity table for each slot, EntityId::invalid_index for holes
+			uint32_t* entitys = nullptr;
+			// released slots below available_count, kept until the owner compacts the block
+			uint64_t* hole_mask = nullptr;
+			size_t hole_count = 0;
+			StorageBlock* partial_front = nullptr;
+			StorageBlock* partial_next = nullptr;
+			// per column, the version of the last mutable access and of the last added component
+			uint64_t* changed_versions = nullptr;
+			uint64_t* added_versions = nullptr;
+			// per column, bits of disabled components and the count of them, each column has mask_count words
+			uint64_t* disable_mask = nullptr;
+			uint64_t* disable_count = nullptr;
+			size_t mask_count = 0;
+		};
+
+		// dense pages of a sparse component, the sparse pages map the index of entity to dense index + 1
+		struct SparseComponentSet
+		{
+			static constexpr size_t sparse_page_bits = 10;
+			TypeInfo type;
+			StorageBlockFunctionPair functions;
+			size_t stride = 0;
+			size_t page_element_count = 0;
+			size_t count = 0;
+			std::vector<std::unique_ptr<size_t[]>> sparse_pages;
+			// page buffer and its aligned data
+			std::vector<std::pair<std::byte*, std::byte*>> dense_pages;
+			std::vector<uint32_t> entitys;
+
+			void* data(size_t index) const noexcept {
+				return dense_pages[index / page_element_count].second + (index % page_element_count) * stride;
+			}
+			size_t* slot(size_t id) const noexcept {
+				size_t page = id >> sparse_page_bits;
+				if (page < sparse_pages.size() && sparse_pages[page])
+					return sparse_pages[page].get() + (id & ((size_t(1) << sparse_page_bits) - 1));
+				return nullptr;
+			}
+			void* find(size_t id) const noexcept {
+				size_t* result = slot(id);
+				return (result != nullptr && *result != 0) ? data(*result - 1) : nullptr;
+			}
 		};
 
+		// value should not be zero
+		inline size_t lowest_set_bit(uint64_t value) noexcept
+		{
+#ifdef _MSC_VER
+			unsigned long index = 0;
+			_BitScanForward64(&index, value);
+			return index;
+#else
+			return static_cast<size_t>(__builtin_ctzll(value));
+#endif
+		}
+
+		inline bool is_disabled(const StorageBlock* block, size_t column, size_t index) noexcept
+		{
+			return (block->disable_mask[column * block->mask_count + index / 64] & (uint64_t(1) << (index % 64))) != 0;
+		}
+
+		inline void set_disabled(StorageBlock* block, size_t column, size_t index, bool disabled) noexcept
+		{
+			uint64_t& word = block->disable_mask[column * block->mask_count + index / 64];
+			uint64_t bit = uint64_t(1) << (index % 64);
+			if (disabled && (word & bit) == 0)
+			{
+				word |= bit;
+				++block->disable_count[column];
+			}
+			else if (!disabled && (word & bit) != 0)
+			{
+				word &= ~bit;
+				--block->disable_count[column];
+			}
+		}
+
 		template<typename T> struct AcceptableTypeDetector {
 			using pure_type = std::remove_reference_t<std::remove_cv_t<T>>;
 			static constexpr bool is_const = std::is_same_v<T, std::add_const_t<pure_type>>;
@@ -6,19 +6,182 @@
 namespace Noodles
 {
 
+	// only visit the blocks whose component has been written or added since the last run of the system
+	template<typename CompT> struct Changed {};
+	template<typename CompT> struct Added {};
+
 	namespace Implement
 	{
+		template<typename CompT> struct ComponentStorageDetector
+		{
+			static constexpr bool sparse = SparseComponent<std::remove_cv_t<CompT>>::value;
+			static constexpr bool tag = std::is_empty_v<CompT> && std::is_trivially_destructible_v<CompT>;
+			// tags are never stored, every reference to a tag refers to this one stateless instance
+			static CompT& tag_instance() noexcept {
+				static_assert(tag, "only tags share one instance");
+				static std::remove_cv_t<CompT> instance{};
+				return instance;
+			}
+			static StorageBlockFunctionPair functions() noexcept {
+				StorageBlockFunctionPair result;
+				// tags have no storage, nothing to move even if they are not trivially copyable
+				if constexpr (!tag && (!std::is_trivially_copyable_v<CompT> || !std::is_trivially_destructible_v<CompT>))
+				{
+					result.destructor = [](void* in) noexcept { static_cast<CompT*>(in)->~CompT(); };
+					result.mover = [](void* target, void* source) noexcept {
+						new (target) CompT{ std::move(*reinterpret_cast<CompT*>(source)) };
+					};
+				}
+				return result;
+			}
+		};
+
+		template<typename CompT> struct ComponentFilterDetector
+		{
+			using type = CompT;
+			static bool accept(const StorageBlock* block, size_t index, uint64_t version) noexcept { return true; }
+		};
+
+		template<typename CompT> struct ComponentFilterDetector<Changed<CompT>>
+		{
+			static_assert(!ComponentStorageDetector<CompT>::sparse, "Changed does not accept sparse component!");
+			using type = CompT;
+			static bool accept(const StorageBlock* block, size_t index, uint64_t version) noexcept { return block->changed_versions[index] > version; }
+		};
+
+		template<typename CompT> struct ComponentFilterDetector<Added<CompT>>
+		{
+			static_assert(!ComponentStorageDetector<CompT>::sparse, "Added does not accept sparse component!");
+			using type = CompT;
+			static bool accept(const StorageBlock* block, size_t index, uint64_t version) noexcept { return block->added_versions[index] > version; }
+		};
+
+		template<typename ...CompT> struct ComponentVersionHelper
+		{
+			static bool accept(const StorageBlock* block, const size_t* index, uint64_t version) noexcept {
+				return accept(block, index, version, std::index_sequence_for<CompT...>{});
+			}
+			// mutable access is known statically, so the whole column is stamped
+			static void stamp(StorageBlock* block, const size_t* index, uint64_t version) noexcept {
+				stamp(block, index, version, std::index_sequence_for<CompT...>{});
+			}
+		private:
+			template<size_t ...i> static bool accept(const StorageBlock* block, const size_t* index, uint64_t version, std::index_sequence<i...>) noexcept {
+				return (true && ... && ComponentFilterDetector<CompT>::accept(block, index[i], version));
+			}
+			template<size_t ...i> static void stamp(StorageBlock* block, const size_t* index, uint64_t version, std::index_sequence<i...>) noexcept {
+				((AcceptableTypeDetector<typename ComponentFilterDetector<CompT>::type>::is_pure && !ComponentStorageDetector<typename ComponentFilterDetector<CompT>::type>::sparse
+					? (void)(block->changed_versions[index[i]] = version) : (void)0), ...);
+			}
+		};
+
+		// sparse components have no column and can not be disabled
+		template<typename ...CompT> struct ComponentEnableHelper
+		{
+			static constexpr size_t count = sizeof...(CompT);
+			static constexpr bool sparse[] = { ComponentStorageDetector<CompT>::sparse... };
+			static bool any_disabled(const StorageBlock* block, const size_t* index) noexcept {
+				for (size_t i = 0; i < count; ++i)
+					if (!sparse[i] && block->disable_count[index[i]] != 0)
+						return true;
+				return false;
+			}
+			// the element at slot has at least one disabled component
+			static bool is_disabled(const StorageBlock* block, const size_t* index, size_t slot) noexcept {
+				for (size_t i = 0; i < count; ++i)
+					if (!sparse[i] && block->disable_count[index[i]] != 0 && Implement::is_disabled(block, index[i], slot))
+						return true;
+				return false;
+			}
+			// every element of the block has at least one disabled component
+			static bool all_disabled(const StorageBlock* block, const size_t* index) noexcept {
+				size_t live_count = block->available_count - block->hole_count;
+				for (size_t i = 0; i < count; ++i)
+					if (!sparse[i] && block->disable_count[index[i]] == live_count)
+						return true;
+				return false;
+			}
+			// first slot not less than start whose components are all enabled, 64 slots per step
+			static size_t next_enabled(const StorageBlock* block, const size_t* index, size_t start) noexcept {
+				for (size_t word = start / 64; word * 64 < block->available_count; ++word)
+				{
+					uint64_t disabled = 0;
+					for (size_t i = 0; i < count; ++i)
+						if (!sparse[i])
+							disabled |= block->disable_mask[index[i] * block->mask_count + word];
+					uint64_t enabled = ~disabled;
+					if (word == start / 64)
+						enabled &= ~uint64_t(0) << (start % 64);
+					if (enabled != 0)
+					{
+						size_t result = word * 64 + lowest_set_bit(enabled);
+						return result < block->available_count ? result : block->available_count;
+					}
+				}
+				return block->available_count;
+			}
+			// first slot not less than start which is (usable ? : not) a live entity with all components enabled
+			static size_t next_usable(const StorageBlock* block, const size_t* index, bool disabled, size_t start, bool usable) noexcept {
+				if (!disabled && block->hole_count == 0)
+					return usable ? std::min(start, block->available_count) : block->available_count;
+				for (size_t word = start / 64; word * 64 < block->available_count; ++word)
+				{
+					uint64_t unusable = block->hole_mask[word];
+					if (disabled)
+					{
+						for (size_t i = 0; i < count; ++i)
+							if (!sparse[i])
+								unusable |= block->disable_mask[index[i] * block->mask_count + word];
+					}
+					uint64_t target = usable ? ~unusable : unusable;
+					if (word == start / 64)
+						target &= ~uint64_t(0) << (start % 64);
+					if (target != 0)
+					{
+						size_t result = word * 64 + lowest_set_bit(target);
+						return result < block->available_count ? result : block->available_count;
+					}
+				}
+				return block->available_count;
+			}
+		};
+
 		template<size_t start, size_t end> struct ComponentTupleHelper
 		{
 			template<typename TupleType>
 			static void translate(StorageBlock const* block, const size_t* index, TupleType& tuple) {
-				std::get<start>(tuple) =
-					reinterpret_cast<std::remove_reference_t<decltype(std::get<start>(tuple))>>(block->datas[index[start]]);
+				using Pointer = std::remove_reference_t<decltype(std::get<start>(tuple))>;
+				using Detector = ComponentStorageDetector<std::remove_pointer_t<Pointer>>;
+				if constexpr (Detector::tag)
+					std::get<start>(tuple) = &Detector::tag_instance();
+				else if constexpr (!Detector::sparse)
+					std::get<start>(tuple) = reinterpret_cast<Pointer>(block->datas[index[start]]);
 				ComponentTupleHelper<start + 1, end>::translate(block, index, tuple);
 			}
 
 			template<typename TupleType>
-			static void add(TupleType& tuple) { std::get<start>(tuple) += 1; ComponentTupleHelper<start + 1, end>::add(tuple); }
+			static void add(TupleType& tuple, size_t step = 1) {
+				using Pointer = std::remove_reference_t<decltype(std::get<start>(tuple))>;
+				using Detector = ComponentStorageDetector<std::remove_pointer_t<Pointer>>;
+				// tags always point to the shared instance
+				if constexpr (!Detector::sparse && !Detector::tag)
+					std::get<start>(tuple) += step;
+				ComponentTupleHelper<start + 1, end>::add(tuple, step);
+			}
+
+			// point the sparse components to the storage of entity, false if the entity lacks one of them
+			template<typename TupleType>
+			static bool resolve(const SparseComponentSet* const* sets, uint32_t entity, TupleType& tuple) {
+				using Pointer = std::remove_reference_t<decltype(std::get<start>(tuple))>;
+				if constexpr (ComponentStorageDetector<std::remove_pointer_t<Pointer>>::sparse)
+				{
+					void* data = sets[start]->find(entity);
+					if (data == nullptr)
+						return false;
+					std::get<start>(tuple) = static_cast<Pointer>(data);
+				}
+				return ComponentTupleHelper<start + 1, end>::resolve(sets, entity, tuple);
+			}
 		};
 
 		template<size_t end> struct ComponentTupleHelper<end, end>
@@ -27,7 +190,10 @@ namespace Noodles
 			static void translate(const StorageBlock* block, const size_t* index, TupleType& tuple) {}
 
 			template<typename TupleType>
-			static void add(TupleType& tuple) { }
+			static void add(TupleType& tuple, size_t step = 1) { }
+
+			template<typename TupleType>
+			static bool resolve(const SparseComponentSet* const* sets, uint32_t entity, TupleType& tuple) { return true; }
 		};
 	}
 
@@ -43,37 +209,110 @@ namespace Noodles
 
 		struct ComponentPoolInterface
 		{
-			template<typename CompT, typename ...Parameter> CompT& construction_component(EntityInterface* owner, Parameter&& ...pa);
+			template<typename CompT, typename ...Parameter> CompT& construction_component(EntityId owner, Parameter&& ...pa);
+			template<typename ...CompT, typename Func> void construction_components(const EntityId* entities, size_t count, Func&& init);
+
+			virtual EntityTable* entity_table() noexcept = 0;
+			// reuses the slots of destoried entities first
+			virtual void allocate_entity(EntityId* output, size_t count) = 0;
 
 			virtual size_t type_group_count() const noexcept = 0;
+			// groups in [begin, end) of the order of creation, output_tg is nullptr for the ones which do not match
 			virtual void search_type_group(
 				const TypeInfo* require_tl, size_t require_tl_count,
+				size_t begin, size_t end,
 				TypeGroup** output_tg,
 				size_t* output_tl_index
 			) const noexcept = 0;
 
 			virtual size_t find_top_block(TypeGroup ** tg, StorageBlock ** output, size_t length) const noexcept = 0;
-			virtual void construct_component(const TypeInfo& layout, void(*constructor)(void*, void*), void* data, EntityInterface*, void(*deconstructor)(void*) noexcept, void(*mover)(void*, void*) noexcept) = 0;
-			virtual void deconstruct_component(EntityInterface*, const TypeInfo& layout) noexcept = 0;
-			virtual void handle_entity_imp(EntityInterface*, EntityOperator ope) noexcept = 0;
-			void entity_destory(EntityInterface* in) { return handle_entity_imp(in, EntityOperator::Destory); }
-			void entity_delete_all(EntityInterface* in) { return handle_entity_imp(in, EntityOperator::DeleteAll); }
+			virtual void construct_component(const TypeInfo& layout, void(*constructor)(void*, void*), void* data, EntityId, void(*deconstructor)(void*) noexcept, void(*mover)(void*, void*) noexcept) = 0;
+			virtual void deconstruct_component(EntityId, const TypeInfo& layout) noexcept = 0;
+			// constructor fills the staged columns, which are moved into the type group as a whole at the next update
+			virtual void construct_components(
+				const TypeInfo* layouts, const StorageBlockFunctionPair* functions, size_t type_count,
+				const EntityId* entities, size_t count, void(*constructor)(void** columns, size_t count, void* parameter), void* parameter
+			) = 0;
+			virtual void handle_entity_imp(EntityId, EntityOperator ope) noexcept = 0;
+			virtual void reserve_type_group(const TypeInfo* layouts, size_t count, size_t reserve_count) = 0;
+			virtual void shrink_type_group(const TypeInfo* layouts, size_t count) = 0;
+			// entities of every group holding all of layouts
+			virtual void destory_type_groups(const TypeInfo* layouts, size_t count) = 0;
+			// monotonic version used to stamp the columns of storage blocks
+			virtual uint64_t increase_version() noexcept = 0;
+			// nullptr if no entity ever had the sparse component
+			virtual const SparseComponentSet* find_sparse_set(const TypeInfo& type) const noexcept = 0;
+			// function(data, index) for each index in [0, count), idle threads take the rest of indices, returns after all are done
+			virtual void parallel_execute(size_t count, void(*function)(void* data, size_t index), void* data) = 0;
+			void entity_destory(EntityId in) { return handle_entity_imp(in, EntityOperator::Destory); }
+			void entity_delete_all(EntityId in) { return handle_entity_imp(in, EntityOperator::DeleteAll); }
 		};
 
-		template<typename CompT, typename ...Parameter> auto ComponentPoolInterface::construction_component(EntityInterface* owner, Parameter&& ...pa) -> CompT &
+		template<typename CompT, typename ...Parameter> auto ComponentPoolInterface::construction_component(EntityId owner, Parameter&& ...pa) -> CompT &
 		{
+			if constexpr (ComponentStorageDetector<CompT>::tag)
+			{
+				// tag has no storage, the parameters are only consumed by a temporary
+				(void)CompT{ std::forward<Parameter>(pa)... };
+				construct_component(TypeInfo::create<CompT>(), nullptr, nullptr, owner, nullptr, nullptr);
+				return ComponentStorageDetector<CompT>::tag_instance();
+			}
 			CompT* result = nullptr;
 			auto pa_tuple = std::forward_as_tuple(result, std::forward<Parameter>(pa)...);
+			auto functions = ComponentStorageDetector<CompT>::functions();
 			construct_component(TypeInfo::create<CompT>(), [](void* adress, void* para) {
 				auto& ref = *static_cast<decltype(pa_tuple)*>(para);
 				using Type = CompT;
 				std::apply([&](auto& ref, auto&& ...at) { ref = new (adress) Type{ std::forward<decltype(at) &&>(at)... }; }, ref);
-			}, &pa_tuple, owner, [](void* in) noexcept { static_cast<CompT*>(in)->~CompT(); }, [](void* target, void* source) noexcept {
-				new (target) CompT{ std::move(*reinterpret_cast<CompT*>(source)) };
-			});
+			}, &pa_tuple, owner, functions.destructor, functions.mover);
 			return *result;
 		}
 
+		template<typename ...CompT> struct ComponentBatchHelper
+		{
+			// value-initialized column by column, tags refer to the shared instance
+			static std::tuple<CompT*...> construct(void** columns, size_t count) {
+				return construct(columns, count, std::index_sequence_for<CompT...>{});
+			}
+			template<typename T> static T& at(T* column, size_t index) noexcept {
+				if constexpr (ComponentStorageDetector<T>::tag)
+					return *column;
+				else
+					return column[index];
+			}
+		private:
+			template<size_t ...i> static std::tuple<CompT*...> construct(void** columns, size_t count, std::index_sequence<i...>) {
+				return { construct_column<CompT>(columns[i], count)... };
+			}
+			template<typename T> static T* construct_column(void* column, size_t count) {
+				if constexpr (ComponentStorageDetector<T>::tag)
+					return &ComponentStorageDetector<T>::tag_instance();
+				else {
+					T* result = static_cast<T*>(column);
+					for (size_t i = 0; i < count; ++i)
+						new (result + i) T{};
+					return result;
+				}
+			}
+		};
+
+		template<typename ...CompT, typename Func> void ComponentPoolInterface::construction_components(const EntityId* entities, size_t count, Func&& init)
+		{
+			static_assert(sizeof...(CompT) > 0);
+			static_assert(!Potato::Tmp::bool_or<false, ComponentStorageDetector<CompT>::sparse...>::value, "create_entities does not accept sparse component!");
+			const TypeInfo layouts[] = { TypeInfo::create<CompT>()... };
+			const StorageBlockFunctionPair functions[] = { ComponentStorageDetector<CompT>::functions()... };
+			EntityTable* table = entity_table();
+			auto pa_tuple = std::forward_as_tuple(entities, init, table);
+			construct_components(layouts, functions, sizeof...(CompT), entities, count, [](void** columns, size_t count, void* para) {
+				auto& ref = *static_cast<decltype(pa_tuple)*>(para);
+				using Helper = ComponentBatchHelper<CompT...>;
+				auto pointers = Helper::construct(columns, count);
+				for (size_t i = 0; i < count; ++i)
+					std::apply([&](auto* ...pointer) { std::get<1>(ref)(Entity{ std::get<2>(ref), std::get<0>(ref)[i] }, Helper::at(pointer, i)...); }, pointers);
+			}, &pa_tuple);
+		}
+
 	}
 
 	namespace Implement
@@ -87,7 +326,7 @@ namespace Noodles
 	{
 		template<typename ...CompT> struct FilterIteratorWrapper
 		{
-			Entity entity() noexcept { return Entity{ m_entity }; }
+			Entity entity() noexcept { return Entity{ m_table, m_table->id(m_entity) }; }
 			std::tuple<CompT& ...>& components() noexcept { assert(m_ref.has_value()); return *m_ref; }
 
 			
@@ -98,12 +337,14 @@ namespace Noodles
 
 		private:
 
-			void set(Implement::EntityInterface* e_interface, std::tuple<CompT* ...>& pointer)
+			void set(Implement::EntityTable* table, uint32_t entity, std::tuple<CompT* ...>& pointer)
 			{
-				m_entity = e_interface;
+				m_table = table;
+				m_entity = entity;
 				m_ref.emplace(std::apply([](auto ...pointer) { return std::tuple<CompT & ...>{*pointer...}; }, pointer));
 			}
-			Implement::EntityInterface* m_entity = nullptr;
+			Implement::EntityTable* m_table = nullptr;
+			uint32_t m_entity = Implement::EntityId::invalid_index;
 			std::optional<std::tuple<CompT& ...>> m_ref;
 			template<typename ...CompT> friend struct FilterIterator;
 		};
@@ -111,8 +352,9 @@ namespace Noodles
 
 	template<typename ...CompT> struct FilterIterator
 	{
-		Implement::FilterIteratorWrapper<CompT...>& operator*() noexcept { return m_wrapper; }
-		Implement::FilterIteratorWrapper<CompT...>* operator->() noexcept { return &m_wrapper; }
+		using Wrapper = Implement::FilterIteratorWrapper<typename Implement::ComponentFilterDetector<CompT>::type...>;
+		Wrapper& operator*() noexcept { return m_wrapper; }
+		Wrapper* operator->() noexcept { return &m_wrapper; }
 		bool operator==(const FilterIterator& i) const noexcept {
 			return m_current_block == i.m_current_block && m_element_last == i.m_element_last;
 		}
@@ -120,63 +362,136 @@ namespace Noodles
 		FilterIterator& operator++() noexcept;
 
 		FilterIterator(const FilterIterator&) = default;
-		FilterIterator(Implement::StorageBlock ** storage_buffer = nullptr, size_t* type_info = nullptr, size_t storage_buffer_count = 0) noexcept;
+		FilterIterator(
+			Implement::StorageBlock ** storage_buffer = nullptr, size_t* type_info = nullptr, size_t storage_buffer_count = 0, uint64_t last_version = 0, uint64_t version = 0,
+			const Implement::SparseComponentSet* const* sparse_set = nullptr, Implement::EntityTable* entity_table = nullptr
+		) noexcept;
 
 	private:
 
+		using Helper = Implement::ComponentVersionHelper<CompT...>;
+		using EnableHelper = Implement::ComponentEnableHelper<typename Implement::ComponentFilterDetector<CompT>::type...>;
+		static constexpr bool has_sparse = Potato::Tmp::bool_or<false, Implement::ComponentStorageDetector<typename Implement::ComponentFilterDetector<CompT>::type>::sparse...>::value;
+		void next_block() noexcept;
+		bool settle_block() noexcept;
+		bool skip_disabled() noexcept;
+		bool accept_entity() noexcept;
+
 		Implement::StorageBlock ** m_storage_block = nullptr;
 		size_t* m_layout_index = nullptr;
 		Implement::StorageBlock* m_current_block = nullptr;
-		Implement::EntityInterface** m_entity_start = nullptr;
+		uint32_t* m_entity_start = nullptr;
 		size_t m_storage_block_count = 0;
 		size_t m_current_storage_block_index = 0;
 		size_t m_element_last = 0;
-		std::tuple<CompT* ...> m_pointer;
-		Implement::FilterIteratorWrapper<CompT...> m_wrapper;
+		uint64_t m_last_version = 0;
+		uint64_t m_version = 0;
+		bool m_disabled = false;
+		const Implement::SparseComponentSet* const* m_sparse_set = nullptr;
+		Implement::EntityTable* m_entity_table = nullptr;
+		std::tuple<typename Implement::ComponentFilterDetector<CompT>::type* ...> m_pointer;
+		Wrapper m_wrapper;
 		template<typename ...CompT> friend struct Filter;
 	};
 
 	template<typename ...CompT> auto FilterIterator<CompT...>::operator++() noexcept ->FilterIterator&
 	{
 		assert(m_current_block != nullptr);
-		--m_element_last;
-		if (m_element_last != 0)
+		// slots without entity are holes which are not compacted yet
+		while (true)
 		{
-			++m_entity_start;
-			Implement::ComponentTupleHelper<0, sizeof...(CompT)>::add(m_pointer);
-			m_wrapper.set(*m_entity_start, m_pointer);
+			--m_element_last;
+			if (m_element_last != 0)
+			{
+				++m_entity_start;
+				Implement::ComponentTupleHelper<0, sizeof...(CompT)>::add(m_pointer);
+			}
+			else {
+				next_block();
+				if (!settle_block())
+					return *this;
+			}
+			if (m_disabled && !skip_disabled())
+			{
+				m_element_last = 1;
+				continue;
+			}
+			if (accept_entity())
+				break;
 		}
+		m_wrapper.set(m_entity_table, *m_entity_start, m_pointer);
+		return *this;
+	}
+
+	template<typename ...CompT> bool FilterIterator<CompT...>::accept_entity() noexcept
+	{
+		if (*m_entity_start == Implement::EntityId::invalid_index)
+			return false;
+		if constexpr (has_sparse)
+			return Implement::ComponentTupleHelper<0, sizeof...(CompT)>::resolve(m_sparse_set, *m_entity_start, m_pointer);
+		return true;
+	}
+
+	template<typename ...CompT> void FilterIterator<CompT...>::next_block() noexcept
+	{
+		assert(m_current_block != nullptr);
+		if (m_current_block->next != nullptr)
+			m_current_block = m_current_block->next;
 		else {
-			if (m_current_block->next != nullptr)
-				m_current_block = m_current_block->next;
-			else {
-				for (++m_current_storage_block_index; m_current_storage_block_index < m_storage_block_count; ++m_current_storage_block_index)
+			m_current_block = nullptr;
+			for (++m_current_storage_block_index; m_current_storage_block_index < m_storage_block_count; ++m_current_storage_block_index)
+			{
+				if (m_storage_block[m_current_storage_block_index] != nullptr)
 				{
-					if (m_storage_block[m_current_storage_block_index] != nullptr)
-					{
-						m_current_block = m_storage_block[m_current_storage_block_index];
-						break;
-					}
+					m_current_block = m_storage_block[m_current_storage_block_index];
+					break;
 				}
-				if (m_current_storage_block_index == m_storage_block_count)
-					m_current_block = nullptr;
 			}
-			if (m_current_block != nullptr)
+		}
+	}
+
+	// skip the blocks rejected by Changed or Added, stamp the first accepted one
+	template<typename ...CompT> bool FilterIterator<CompT...>::settle_block() noexcept
+	{
+		for (; m_current_block != nullptr; next_block())
+		{
+			const size_t* index = m_layout_index + sizeof...(CompT) * m_current_storage_block_index;
+			if (Helper::accept(m_current_block, index, m_last_version) && !EnableHelper::all_disabled(m_current_block, index))
 			{
 				m_entity_start = m_current_block->entitys;
-				Implement::ComponentTupleHelper<0, sizeof...(CompT)>::translate(m_current_block, m_layout_index + sizeof...(CompT) * m_current_storage_block_index, m_pointer);
-				m_wrapper.set(*m_entity_start, m_pointer);
+				Implement::ComponentTupleHelper<0, sizeof...(CompT)>::translate(m_current_block, index, m_pointer);
 				m_element_last = m_current_block->available_count;
-				assert(*m_current_block->entitys != nullptr);
+				assert(m_element_last != 0);
+				Helper::stamp(m_current_block, index, m_version);
+				m_disabled = EnableHelper::any_disabled(m_current_block, index);
+				return true;
 			}
-			else
-				m_element_last = 0;
 		}
-		return *this;
+		m_element_last = 0;
+		return false;
+	}
+
+	// move to the first slot whose components are all enabled, false if there is none left in the block
+	template<typename ...CompT> bool FilterIterator<CompT...>::skip_disabled() noexcept
+	{
+		size_t available_count = m_current_block->available_count;
+		size_t slot = available_count - m_element_last;
+		size_t target = EnableHelper::next_enabled(m_current_block, m_layout_index + sizeof...(CompT) * m_current_storage_block_index, slot);
+		if (target == available_count)
+			return false;
+		size_t step = target - slot;
+		m_entity_start += step;
+		Implement::ComponentTupleHelper<0, sizeof...(CompT)>::add(m_pointer, step);
+		m_element_last -= step;
+		return true;
 	}
 
-	template<typename ...CompT> FilterIterator<CompT...>::FilterIterator(Implement::StorageBlock ** storage_buffer, size_t* type_info, size_t storage_buffer_count) noexcept
-		: m_storage_block(storage_buffer), m_layout_index(type_info), m_storage_block_count(storage_buffer_count)
+	template<typename ...CompT> FilterIterator<CompT...>::FilterIterator(
+		Implement::StorageBlock ** storage_buffer, size_t* type_info, size_t storage_buffer_count, uint64_t last_version, uint64_t version,
+		const Implement::SparseComponentSet* const* sparse_set, Implement::EntityTable* entity_table
+	) noexcept
+		: m_storage_block(storage_buffer), m_layout_index(type_info), m_storage_block_count(storage_buffer_count), m_last_version(last_version), m_version(version),
+		m_sparse_set(sparse_set), m_entity_table(entity_table)
 	{
 		if(storage_buffer_count > 0 && storage_buffer != nullptr)
 		{
@@ -187,29 +502,260 @@ namespace Noodles
 					break;
 			}
 				
-			if (m_current_block != nullptr)
+			if (settle_block())
 			{
-				m_entity_start = m_current_block->entitys;
-				Implement::ComponentTupleHelper<0, sizeof...(CompT)>::translate(m_current_block, m_layout_index + sizeof...(CompT) * m_current_storage_block_index, m_pointer);
-				m_wrapper.set(*m_entity_start, m_pointer);
-				m_element_last = m_current_block->available_count;
+				if (m_disabled && !skip_disabled())
+					m_element_last = 1;
+				else if (accept_entity())
+				{
+					m_wrapper.set(m_entity_table, *m_entity_start, m_pointer);
+					return;
+				}
+				++(*this);
+			}
+		}
+	}
+
+	// consecutive components of one column
+	template<typename T> struct ComponentSpan
+	{
+		T* data() const noexcept { return m_data; }
+		size_t size() const noexcept { return m_count; }
+		T& operator[](size_t index) const noexcept {
+			assert(index < m_count);
+			if constexpr (Implement::ComponentStorageDetector<T>::tag)
+				return *m_data;
+			else
+				return m_data[index];
+		}
+		// tags have no column to walk, use operator[] instead
+		T* begin() const noexcept { static_assert(!Implement::ComponentStorageDetector<T>::tag, "tags have no storage"); return m_data; }
+		T* end() const noexcept { static_assert(!Implement::ComponentStorageDetector<T>::tag, "tags have no storage"); return m_data + m_count; }
+		ComponentSpan(T* data = nullptr, size_t count = 0) noexcept : m_data(data), m_count(count) {}
+	private:
+		T* m_data;
+		size_t m_count;
+	};
+
+	struct EntitySpan
+	{
+		size_t size() const noexcept { return m_count; }
+		Entity operator[](size_t index) const noexcept { assert(index < m_count); return Entity{ m_table, m_table->id(m_entitys[index]) }; }
+		EntitySpan(Implement::EntityTable* table = nullptr, const uint32_t* entitys = nullptr, size_t count = 0) noexcept
+			: m_table(table), m_entitys(entitys), m_count(count) {}
+	private:
+		Implement::EntityTable* m_table;
+		const uint32_t* m_entitys;
+		size_t m_count;
+	};
+
+	// a run of live entities in one storage block whose components are all enabled,
+	// the first run of a block starts at the column boundary of StorageLayoutPolicy
+	template<typename ...CompT> struct FilterChunk
+	{
+		size_t count = 0;
+		std::tuple<ComponentSpan<CompT>...> components;
+		EntitySpan entitys;
+	};
+
+	template<typename ...CompT> struct FilterChunkIterator
+	{
+		using Chunk = FilterChunk<typename Implement::ComponentFilterDetector<CompT>::type...>;
+		Chunk& operator*() noexcept { return m_chunk; }
+		Chunk* operator->() noexcept { return &m_chunk; }
+		bool operator==(const FilterChunkIterator& i) const noexcept {
+			return m_current_block == i.m_current_block && m_element_end == i.m_element_end;
+		}
+		bool operator!=(const FilterChunkIterator& i) const noexcept { return !((*this) == i); }
+		FilterChunkIterator& operator++() noexcept { assert(m_current_block != nullptr); settle(); return *this; }
+
+		FilterChunkIterator(const FilterChunkIterator&) = default;
+		FilterChunkIterator(
+			Implement::StorageBlock** storage_buffer = nullptr, size_t* type_info = nullptr, size_t storage_buffer_count = 0,
+			uint64_t last_version = 0, uint64_t version = 0, Implement::EntityTable* entity_table = nullptr
+		) noexcept;
+
+		// every chunk of a single block, for threads which share the blocks of a filter
+		template<typename Func> static void for_each_in_block(
+			Implement::StorageBlock* block, const size_t* index, uint64_t last_version, uint64_t version, Implement::EntityTable* entity_table, Func&& func
+		);
+
+	private:
+
+		using Helper = Implement::ComponentVersionHelper<CompT...>;
+		using EnableHelper = Implement::ComponentEnableHelper<typename Implement::ComponentFilterDetector<CompT>::type...>;
+		void next_block() noexcept;
+		void settle() noexcept;
+		// false if the block is rejected by Changed or Added, or all of its entities are disabled
+		static bool enter_block(Implement::StorageBlock* block, const size_t* index, uint64_t last_version, uint64_t version, bool& disabled) noexcept {
+			if (!Helper::accept(block, index, last_version) || EnableHelper::all_disabled(block, index))
+				return false;
+			Helper::stamp(block, index, version);
+			disabled = EnableHelper::any_disabled(block, index);
+			return true;
+		}
+		template<typename T> static ComponentSpan<T> make_span(void* column, size_t begin, size_t count) noexcept {
+			if constexpr (Implement::ComponentStorageDetector<T>::tag)
+				return { &Implement::ComponentStorageDetector<T>::tag_instance(), count };
+			else
+				return { static_cast<T*>(column) + begin, count };
+		}
+		template<size_t ...i> static void set_chunk(
+			Chunk& chunk, Implement::StorageBlock* block, const size_t* index, size_t begin, size_t count, Implement::EntityTable* entity_table, std::index_sequence<i...>
+		) noexcept {
+			chunk.count = count;
+			chunk.components = { make_span<typename Implement::ComponentFilterDetector<CompT>::type>(block->datas[index[i]], begin, count)... };
+			chunk.entitys = EntitySpan{ entity_table, block->entitys + begin, count };
+		}
+
+		Implement::StorageBlock** m_storage_block = nullptr;
+		size_t* m_layout_index = nullptr;
+		Implement::StorageBlock* m_current_block = nullptr;
+		size_t m_storage_block_count = 0;
+		size_t m_current_storage_block_index = 0;
+		// end of the current chunk, 0 before the first chunk of a block
+		size_t m_element_end = 0;
+		uint64_t m_last_version = 0;
+		uint64_t m_version = 0;
+		bool m_disabled = false;
+		Implement::EntityTable* m_entity_table = nullptr;
+		Chunk m_chunk;
+	};
+
+	template<typename ...CompT> void FilterChunkIterator<CompT...>::next_block() noexcept
+	{
+		assert(m_current_block != nullptr);
+		m_element_end = 0;
+		if (m_current_block->next != nullptr)
+			m_current_block = m_current_block->next;
+		else {
+			m_current_block = nullptr;
+			for (++m_current_storage_block_index; m_current_storage_block_index < m_storage_block_count; ++m_current_storage_block_index)
+			{
+				if (m_storage_block[m_current_storage_block_index] != nullptr)
+				{
+					m_current_block = m_storage_block[m_current_storage_block_index];
+					break;
+				}
 			}
 		}
 	}
 
+	// skip the blocks rejected by Changed or Added, stamp the accepted ones when entered
+	template<typename ...CompT> void FilterChunkIterator<CompT...>::settle() noexcept
+	{
+		while (m_current_block != nullptr)
+		{
+			const size_t* index = m_layout_index + sizeof...(CompT) * m_current_storage_block_index;
+			if (m_element_end == 0 && !enter_block(m_current_block, index, m_last_version, m_version, m_disabled))
+			{
+				next_block();
+				continue;
+			}
+			size_t begin = EnableHelper::next_usable(m_current_block, index, m_disabled, m_element_end, true);
+			if (begin < m_current_block->available_count)
+			{
+				size_t end = EnableHelper::next_usable(m_current_block, index, m_disabled, begin, false);
+				set_chunk(m_chunk, m_current_block, index, begin, end - begin, m_entity_table, std::index_sequence_for<CompT...>{});
+				m_element_end = end;
+				return;
+			}
+			next_block();
+		}
+	}
+
+	template<typename ...CompT> template<typename Func> void FilterChunkIterator<CompT...>::for_each_in_block(
+		Implement::StorageBlock* block, const size_t* index, uint64_t last_version, uint64_t version, Implement::EntityTable* entity_table, Func&& func
+	)
+	{
+		bool disabled = false;
+		if (!enter_block(block, index, last_version, version, disabled))
+			return;
+		Chunk chunk;
+		for (size_t begin = EnableHelper::next_usable(block, index, disabled, 0, true); begin < block->available_count; begin = EnableHelper::next_usable(block, index, disabled, begin, true))
+		{
+			size_t end = EnableHelper::next_usable(block, index, disabled, begin, false);
+			set_chunk(chunk, block, index, begin, end - begin, entity_table, std::index_sequence_for<CompT...>{});
+			func(chunk);
+			begin = end;
+		}
+	}
+
+	template<typename ...CompT> FilterChunkIterator<CompT...>::FilterChunkIterator(
+		Implement::StorageBlock** storage_buffer, size_t* type_info, size_t storage_buffer_count,
+		uint64_t last_version, uint64_t version, Implement::EntityTable* entity_table
+	) noexcept
+		: m_storage_block(storage_buffer), m_layout_index(type_info), m_storage_block_count(storage_buffer_count),
+		m_last_version(last_version), m_version(version), m_entity_table(entity_table)
+	{
+		if (storage_buffer_count > 0 && storage_buffer != nullptr)
+		{
+			for (; m_current_storage_block_index < m_storage_block_count; ++m_current_storage_block_index)
+			{
+				m_current_block = storage_buffer[m_current_storage_block_index];
+				if (m_current_block != nullptr)
+					break;
+			}
+			settle();
+		}
+	}
+
+	template<typename ...CompT> struct FilterChunkView
+	{
+		FilterChunkIterator<CompT...> begin() const noexcept { return m_begin; }
+		FilterChunkIterator<CompT...> end() const noexcept { return {}; }
+		FilterChunkView(const FilterChunkIterator<CompT...>& begin) noexcept : m_begin(begin) {}
+	private:
+		FilterChunkIterator<CompT...> m_begin;
+	};
+
 	namespace Implement
 	{
 		template<typename ...CompT>
 		struct FilterBase
 		{
+			static_assert(Potato::Tmp::bool_or<false, !ComponentStorageDetector<CompT>::sparse...>::value, "Filter needs a component which is not sparse!");
 			void envirment_change(bool system, bool gobalcomponent, bool component);
 			static void export_rw_info(Implement::ReadWritePropertyMap& tuple) noexcept { Implement::TypeInfoListExtractor<CompT...>{}(tuple.components); }
 			void export_type_group_used(const TypeInfo* conflig_type, size_t conflig_count, Implement::ReadWriteProperty*) const noexcept;
 			FilterBase(Implement::ComponentPoolInterface* ptr) noexcept : m_pool(ptr) { assert(m_pool); }
+			uint64_t acquire_version() noexcept { return m_pool->increase_version(); }
+			void parallel_execute(size_t count, void(*function)(void* data, size_t index), void* data) { m_pool->parallel_execute(count, function, data); }
+			template<typename T> static constexpr size_t locate_component() noexcept {
+				constexpr bool match[] = { std::is_same_v<std::remove_const_t<T>, std::remove_const_t<CompT>>... };
+				for (size_t i = 0; i < sizeof...(CompT); ++i)
+					if (match[i])
+						return i;
+				return sizeof...(CompT);
+			}
+			template<typename T> static constexpr bool is_writable() noexcept {
+				return Potato::Tmp::bool_or<false, std::is_same_v<T, CompT>...>::value && AcceptableTypeDetector<T>::is_pure && !ComponentStorageDetector<T>::sparse;
+			}
+			template<typename T> static constexpr bool is_toggleable() noexcept {
+				return locate_component<T>() < sizeof...(CompT) && !ComponentStorageDetector<T>::sparse;
+			}
+			bool set_enable(EntityId entity, size_t position, bool enable) noexcept;
+			bool is_enable(EntityId entity, size_t position) const noexcept;
+			EntityTable* entity_table() const noexcept { return m_pool->entity_table(); }
 			size_t update_component(std::vector<StorageBlock*>& p) {
 				p.resize(m_type_group_count);
 				return 	m_pool->find_top_block(m_all_type_group.data(), p.data(), m_type_group_count);
 			}
+			// false if one of the sparse components is never added
+			bool update_sparse_set() noexcept {
+				using Infos = Implement::TypeInfoList<CompT...>;
+				bool exist = true;
+				for (size_t i = 0; i < sizeof...(CompT); ++i)
+				{
+					if (Infos::info()[i].sparse)
+					{
+						m_sparse_set[i] = m_pool->find_sparse_set(Infos::info()[i]);
+						exist = exist && m_sparse_set[i] != nullptr;
+					}
+				}
+				return exist;
+			}
+			const SparseComponentSet* const* sparse_set() const noexcept { return m_sparse_set.data(); }
 			size_t* layout_index() noexcept { return m_type_layout_index.data(); }
 			size_t type_group_count() const noexcept { return m_type_group_count; }
 			size_t* find_type_layout(const Implement::TypeGroup* input) const noexcept {
@@ -223,9 +769,15 @@ namespace Noodles
 			}
 		private:
 			observer_ptr<Implement::ComponentPoolInterface> m_pool;
+			// only the matching groups, appended as new groups are created
 			std::vector<TypeGroup*> m_all_type_group;
+			// index of each group in the pool
+			std::vector<size_t> m_type_group_index;
 			std::vector<size_t> m_type_layout_index;
 			size_t m_type_group_count = 0;
+			// groups of the pool which are already searched
+			size_t m_searched_count = 0;
+			std::array<const SparseComponentSet*, sizeof...(CompT)> m_sparse_set{};
 		};
 
 		template<typename ...CompT> void FilterBase<CompT...>::export_type_group_used(const TypeInfo* conflig_type, size_t conflig_count, Implement::ReadWriteProperty* mapping) const noexcept
@@ -249,73 +801,200 @@ namespace Noodles
 				size_t index = 0;
 				for (size_t index = 0; index < m_type_group_count; ++index)
 				{
-					if (m_all_type_group[index] != nullptr)
-					{
-						if constexpr (Potato::Tmp::bool_or<false, Implement::AcceptableTypeDetector<CompT>::is_pure...>::value)
-							mapping[index] = Implement::ReadWriteProperty::Write;
-						else {
-							auto& ref = mapping[index];
-							if (ref == Implement::ReadWriteProperty::Unknow)
-								ref = Implement::ReadWriteProperty::Read;
-						}
-					}
+					auto& ref = mapping[m_type_group_index[index]];
+					if constexpr (Potato::Tmp::bool_or<false, Implement::AcceptableTypeDetector<CompT>::is_pure...>::value)
+						ref = Implement::ReadWriteProperty::Write;
+					else if (ref == Implement::ReadWriteProperty::Unknow)
+						ref = Implement::ReadWriteProperty::Read;
 				}
 			}
 		}
 
+		template<typename ...CompT> bool FilterBase<CompT...>::set_enable(EntityId entity, size_t position, bool enable) noexcept
+		{
+			assert(position < sizeof...(CompT));
+			const EntitySlot* slot = entity_table()->find(entity);
+			if (slot != nullptr && slot->block != nullptr)
+			{
+				size_t* infos = find_type_layout(slot->block->m_owner);
+				if (infos != nullptr)
+				{
+					set_disabled(slot->block, infos[position], slot->index, !enable);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		template<typename ...CompT> bool FilterBase<CompT...>::is_enable(EntityId entity, size_t position) const noexcept
+		{
+			assert(position < sizeof...(CompT));
+			const EntitySlot* slot = entity_table()->find(entity);
+			if (slot != nullptr && slot->block != nullptr)
+			{
+				size_t* infos = find_type_layout(slot->block->m_owner);
+				if (infos != nullptr)
+					return !is_disabled(slot->block, infos[position], slot->index);
+			}
+			return false;
+		}
+
 		template<typename ...CompT> void FilterBase<CompT...>::envirment_change(bool system, bool gobalcomponent, bool component)
 		{
 			if (component)
 			{
 				using Infos = Implement::TypeInfoList<CompT...>;
-				m_type_group_count = m_pool->type_group_count();
-				m_all_type_group.resize(m_type_group_count);
-				m_type_layout_index.resize(m_type_group_count * sizeof...(CompT));
-				m_pool->search_type_group(
-					Infos::info().data(),
-					Infos::info().size(),
-					m_all_type_group.data(),
-					m_type_layout_index.data()
-				);
+				size_t count = m_pool->type_group_count();
+				// groups are only freed all at once
+				if (count < m_searched_count)
+				{
+					m_all_type_group.clear();
+					m_type_group_index.clear();
+					m_type_layout_index.clear();
+					m_type_group_count = 0;
+					m_searched_count = 0;
+				}
+				if (count > m_searched_count)
+				{
+					std::vector<TypeGroup*> groups(count - m_searched_count);
+					std::vector<size_t> layout_index(groups.size() * sizeof...(CompT));
+					m_pool->search_type_group(
+						Infos::info().data(),
+						Infos::info().size(),
+						m_searched_count, count,
+						groups.data(),
+						layout_index.data()
+					);
+					for (size_t i = 0; i < groups.size(); ++i)
+					{
+						if (groups[i] != nullptr)
+						{
+							m_all_type_group.push_back(groups[i]);
+							m_type_group_index.push_back(m_searched_count + i);
+							m_type_layout_index.insert(m_type_layout_index.end(), layout_index.begin() + i * sizeof...(CompT), layout_index.begin() + (i + 1) * sizeof...(CompT));
+						}
+					}
+					m_type_group_count = m_all_type_group.size();
+					m_searched_count = count;
+				}
 			}
 		}
 	}
 
-	template<typename ...CompT> struct Filter : protected Implement::FilterBase<CompT...>
+	template<typename ...CompT> struct Filter : protected Implement::FilterBase<typename Implement::ComponentFilterDetector<CompT>::type...>
 	{
-		using Super = Implement::FilterBase<CompT...>;
+		using Super = Implement::FilterBase<typename Implement::ComponentFilterDetector<CompT>::type...>;
 
-		static_assert(Potato::Tmp::bool_and<true, Implement::AcceptableTypeDetector<CompT>::value...>::value, "Filter only accept Type and const Type!");
+		static_assert(Potato::Tmp::bool_and<true, Implement::AcceptableTypeDetector<typename Implement::ComponentFilterDetector<CompT>::type>::value...>::value, "Filter only accept Type and const Type!");
 
 		FilterIterator<CompT...> begin() noexcept {
-			return FilterIterator<CompT...>{ m_top_block.data(), Super::layout_index(), Super::type_group_count() };
+			if (!m_sparse_ready)
+				return end();
+			return FilterIterator<CompT...>{ m_top_block.data(), Super::layout_index(), Super::type_group_count(), m_last_version, m_version, Super::sparse_set(), Super::entity_table() };
 		}
 		FilterIterator<CompT...> end() noexcept { return FilterIterator<CompT...>{}; }
+		// Changed, Added, sparse and disabled components are not taken into account
 		size_t count() const noexcept { return m_total_element_count; }
 
+		// components of each chunk are contiguous, for loops which the compiler could vectorize
+		FilterChunkView<CompT...> chunks() noexcept {
+			static_assert(!Potato::Tmp::bool_or<false, Implement::ComponentStorageDetector<typename Implement::ComponentFilterDetector<CompT>::type>::sparse...>::value, "chunks does not accept sparse component!");
+			return FilterChunkIterator<CompT...>{ m_top_block.data(), Super::layout_index(), Super::type_group_count(), m_last_version, m_version, Super::entity_table() };
+		}
+		// func(size_t count, ComponentSpan<CompT>..., EntitySpan) for each chunk
+		template<typename Func> void for_each_chunk(Func&& func) {
+			for (auto& chunk : chunks())
+				std::apply([&](auto& ...span) { func(chunk.count, span..., chunk.entitys); }, chunk.components);
+		}
+		// the same as for_each_chunk, but blocks are shared with idle threads in tasks of about grain entities,
+		// func is called concurrently and returns after all chunks are done
+		template<typename Func> void parallel_for_each(Func&& func, size_t grain = 1024);
+
+		// disabled components are skipped by iterators without moving the entity, visible to the following systems at once
+		template<typename T> bool set_enable(const Entity& entity, bool enable) noexcept {
+			static_assert(Super::template is_writable<T>(), "set_enable only accept writable Type of the Filter which is not sparse!");
+			return entity && Super::set_enable(entity.m_id, Super::template locate_component<T>(), enable);
+		}
+		template<typename T> bool is_enable(const Entity& entity) const noexcept {
+			static_assert(Super::template is_toggleable<T>(), "is_enable only accept Type of the Filter which is not sparse!");
+			return entity && Super::is_enable(entity.m_id, Super::template locate_component<T>());
+		}
+
 	protected:
 
-		Filter(Implement::ComponentPoolInterface* pool) noexcept : Implement::FilterBase<CompT...>(pool) {}
+		Filter(Implement::ComponentPoolInterface* pool) noexcept : Super(pool) {}
 
-		void pre_apply() noexcept { m_total_element_count = Super::update_component(m_top_block); }
-		void pos_apply() noexcept {}
+		void pre_apply() noexcept {
+			m_total_element_count = Super::update_component(m_top_block);
+			m_sparse_ready = Super::update_sparse_set();
+			m_version = Super::acquire_version();
+		}
+		void pos_apply() noexcept { m_last_version = m_version; }
 
 		std::vector<Implement::StorageBlock*> m_top_block;
 		size_t m_total_element_count;
+		bool m_sparse_ready = false;
+		uint64_t m_last_version = 0;
+		uint64_t m_version = 0;
 
 		template<typename Require> friend struct Implement::FilterAndEventAndSystem;
 	};
 
+	template<typename ...CompT> template<typename Func> void Filter<CompT...>::parallel_for_each(Func&& func, size_t grain)
+	{
+		static_assert(!Potato::Tmp::bool_or<false, Implement::ComponentStorageDetector<typename Implement::ComponentFilterDetector<CompT>::type>::sparse...>::value, "parallel_for_each does not accept sparse component!");
+		// blocks with the group they belong to, a task takes consecutive blocks
+		std::vector<std::tuple<Implement::StorageBlock*, size_t>> blocks;
+		std::vector<size_t> task_start;
+		size_t element_count = 0;
+		for (size_t i = 0; i < m_top_block.size(); ++i)
+		{
+			for (auto block = m_top_block[i]; block != nullptr; block = block->next)
+			{
+				if (element_count == 0)
+					task_start.push_back(blocks.size());
+				blocks.push_back({ block, i });
+				element_count += block->available_count;
+				if (element_count >= grain)
+					element_count = 0;
+			}
+		}
+		task_start.push_back(blocks.size());
+		auto execute = [&](size_t task) {
+			for (size_t i = task_start[task]; i < task_start[task + 1]; ++i)
+			{
+				auto [block, group] = blocks[i];
+				FilterChunkIterator<CompT...>::for_each_in_block(block, Super::layout_index() + sizeof...(CompT) * group, m_last_version, m_version, Super::entity_table(), [&](auto& chunk) {
+					std::apply([&](auto& ...span) { func(chunk.count, span..., chunk.entitys); }, chunk.components);
+				});
+			}
+		};
+		Super::parallel_execute(task_start.size() - 1, [](void* data, size_t index) { (*static_cast<decltype(execute)*>(data))(index); }, &execute);
+	}
+
 	template<typename ...CompT> struct EntityFilter : protected Implement::FilterBase<CompT...>
 	{
 		using Super = Implement::FilterBase<CompT...>;
 		static_assert(Potato::Tmp::bool_and<true, Implement::AcceptableTypeDetector<CompT>::value...>::value, "EntityFilter only accept Type and const Type!");
 		template<typename Func>
 		void operator()(const Entity& wrapper, Func&& f);
+		template<typename T> bool set_enable(const Entity& entity, bool enable) noexcept {
+			static_assert(Super::template is_writable<T>(), "set_enable only accept writable Type of the EntityFilter which is not sparse!");
+			return entity && Super::set_enable(entity.m_id, Super::template locate_component<T>(), enable);
+		}
+		template<typename T> bool is_enable(const Entity& entity) const noexcept {
+			static_assert(Super::template is_toggleable<T>(), "is_enable only accept Type of the EntityFilter which is not sparse!");
+			return entity && Super::is_enable(entity.m_id, Super::template locate_component<T>());
+		}
 	private:
 		EntityFilter(Implement::ComponentPoolInterface* pool) noexcept : Implement::FilterBase<CompT...>(pool) { }
-		void pre_apply() noexcept {}
+		void pre_apply() noexcept {
+			m_sparse_ready = Super::update_sparse_set();
+			m_version = Super::acquire_version();
+		}
 		void pos_apply() noexcept {}
+		uint64_t m_version = 0;
+		bool m_sparse_ready = false;
 		template<typename Require> friend struct Implement::FilterAndEventAndSystem;
 	};
 
@@ -324,17 +1003,20 @@ namespace Noodles
 	{
 		if (wrapper)
 		{
-			Implement::TypeGroup* group;
-			Implement::StorageBlock* block;
-			size_t index;
-			wrapper.m_imp->read(group, block, index);
-			if (group != nullptr)
+			const Implement::EntitySlot* slot = wrapper.m_table->find(wrapper.m_id);
+			if (slot != nullptr && slot->block != nullptr)
 			{
-				size_t* infos = Super::find_type_layout(group);
-				if (infos != nullptr)
+				Implement::StorageBlock* block = slot->block;
+				size_t* infos = Super::find_type_layout(block->m_owner);
+				// entities with a disabled component are skipped as the iteration of Filter does
+				if (infos != nullptr && m_sparse_ready && !Implement::ComponentEnableHelper<CompT...>::is_disabled(block, infos, slot->index))
 				{
 					std::tuple<std::remove_reference_t<CompT>* ...> component_pointer;
 					Implement::ComponentTupleHelper<0, sizeof...(CompT)>::translate(block, infos, component_pointer);
+					Implement::ComponentTupleHelper<0, sizeof...(CompT)>::add(component_pointer, slot->index);
+					if (!Implement::ComponentTupleHelper<0, sizeof...(CompT)>::resolve(Super::sparse_set(), wrapper.m_id.index, component_pointer))
+						return;
+					Implement::ComponentVersionHelper<CompT...>::stamp(block, infos, m_version);
 					std::apply([&](auto ...pointer) {
 						std::forward<Func>(f)(*pointer...);
 					}, component_pointer);
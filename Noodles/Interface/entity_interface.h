@@ -1,45 +1,90 @@
 #pragma once
 #include "aid.h"
 #include <assert.h>
+#include <atomic>
 namespace Noodles
 {
 	namespace Implement
 	{
-		struct EntityInterface
+		// location of an entity, block is nullptr if it has no component in type groups
+		struct EntitySlot
 		{
-			virtual void add_ref() const noexcept = 0;
-			virtual void sub_ref() const noexcept = 0;
-			virtual void read(TypeGroup*&, StorageBlock*&, size_t& index) const noexcept = 0;
-			virtual void set(TypeGroup*, StorageBlock*, size_t index) noexcept = 0;
-			virtual bool have(const TypeInfo*, size_t index) const noexcept = 0;
+			StorageBlock* block = nullptr;
+			uint32_t index = 0;
+			uint32_t generation = 0;
 		};
 
-		using EntityInterfacePtr = intrusive_ptr<EntityInterface>;
+		// slots are kept in chunks which never move, so they are read without lock
+		struct EntityTable
+		{
+			static constexpr size_t chunk_bits = 16;
+			static constexpr size_t chunk_count = size_t(1) << (32 - chunk_bits);
+			EntitySlot& slot(uint32_t index) const noexcept {
+				return m_chunks[index >> chunk_bits][index & ((uint32_t(1) << chunk_bits) - 1)];
+			}
+			// nullptr if the entity is destoried
+			EntitySlot* find(EntityId id) const noexcept {
+				EntitySlot& result = slot(id.index);
+				return result.generation == id.generation ? &result : nullptr;
+			}
+			EntityId id(uint32_t index) const noexcept { return { index, slot(index).generation }; }
+			void locate(uint32_t index, StorageBlock* block, size_t position) const noexcept {
+				EntitySlot& result = slot(index);
+				result.block = block;
+				result.index = static_cast<uint32_t>(position);
+			}
+			// dense id of the component type, assigned at the first use and kept for the life of the table
+			virtual size_t component_id(const TypeInfo& type) = 0;
+			uint32_t serial() const noexcept { return m_serial; }
+			// sparse[i] tells the component is kept in a sparse set instead of the type group
+			virtual bool have(EntityId id, const size_t* component_ids, const bool* sparse, size_t count) const noexcept = 0;
+		protected:
+			EntitySlot** m_chunks = nullptr;
+			uint32_t m_serial = 0;
+		};
+
+		// the id is cached with the serial of the table, so a type asks the table only once
+		template<typename CompT> size_t component_id(EntityTable& table)
+		{
+			static std::atomic_uint64_t cache = 0;
+			uint64_t value = cache.load(std::memory_order_relaxed);
+			if ((value >> 32) == table.serial())
+				return static_cast<size_t>(value & std::numeric_limits<uint32_t>::max());
+			size_t id = table.component_id(TypeInfo::create<std::remove_cv_t<CompT>>());
+			assert(id < std::numeric_limits<uint32_t>::max());
+			cache.store((uint64_t(table.serial()) << 32) | id, std::memory_order_relaxed);
+			return id;
+		}
 	}
 
 	struct Context;
 	template<typename ...CompT> struct EntityFilter;
+	template<typename ...CompT> struct Filter;
 
 	struct Entity
 	{
-		operator bool() const noexcept { return m_imp; }
+		operator bool() const noexcept { return m_table != nullptr; }
+		// false for a destoried entity
 		template<typename ...Type> bool have() const noexcept
 		{
-			assert(m_imp);
-			std::array<TypeInfo, sizeof...(Type)> infos = { TypeInfo::create<Type>()... };
-			return m_imp->have(infos.data(), infos.size());
+			assert(m_table != nullptr);
+			std::array<size_t, sizeof...(Type)> ids = { Implement::component_id<Type>(*m_table)... };
+			std::array<bool, sizeof...(Type)> sparse = { SparseComponent<std::remove_cv_t<Type>>::value... };
+			return m_table->have(m_id, ids.data(), sparse.data(), ids.size());
 		}
 		Entity(const Entity&) = default;
 		Entity(Entity&&) = default;
 		Entity() = default;
 		Entity& operator=(const Entity&) = default;
 		Entity& operator=(Entity&&) = default;
-		Entity(Implement::EntityInterfacePtr ptr) : m_imp(std::move(ptr)) {}
+		Entity(Implement::EntityTable* table, Implement::EntityId id) noexcept : m_table(table), m_id(id) {}
 	private:
-		Implement::EntityInterfacePtr m_imp;
+		Implement::EntityTable* m_table = nullptr;
+		Implement::EntityId m_id;
 
 		friend struct EntityWrapper;
 		template<typename ...CompT> friend struct EntityFilter;
+		template<typename ...CompT> friend struct Filter;
 		friend struct Context;
 	};
 
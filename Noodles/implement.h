@@ -24,6 +24,11 @@ namespace Noodles
 		virtual void exit() noexcept override;
 		void set_minimum_duration(std::chrono::milliseconds ds) noexcept { m_target_duration = ds; }
 		void set_thread_reserved(size_t tr) noexcept { m_thread_reserved = tr; }
+		void set_memory_page_source(Implement::MemoryPageSource source) noexcept { allocator.set_page_source(source); }
+		void set_compaction_budget(size_t move, std::chrono::microseconds duration = std::chrono::microseconds{ 0 }) noexcept { component_pool.set_compaction_budget(move, duration); }
+		void set_memory_decay_policy(const Implement::MemoryDecayPolicy& policy) noexcept { allocator.set_decay_policy(policy); }
+		void set_storage_layout_policy(const Implement::StorageLayoutPolicy& policy) noexcept { component_pool.set_storage_layout_policy(policy); }
+		Implement::MemoryPageAllocator::Statistics memory_statistics() const noexcept { return allocator.statistics(); }
 		ContextImplement() noexcept;
 	private:
 		virtual void insert_asynchronous_work_imp(Implement::AsynchronousWorkInterface* ptr) override;
@@ -31,9 +36,9 @@ namespace Noodles
 		virtual operator Implement::GobalComponentPoolInterface* () override;
 		virtual operator Implement::EventPoolInterface* () override;
 		virtual operator Implement::SystemPoolInterface* () override;
-		virtual Implement::EntityInterfacePtr create_entity_imp() override;
 		virtual float duration_s() const noexcept override;
-		static void append_execute_function(ContextImplement*) noexcept;
+		virtual std::pmr::memory_resource* frame_allocator() noexcept override;
+		static void append_execute_function(ContextImplement*, Implement::FrameMemoryResource*) noexcept;
 		bool apply_asynchronous_work();
 		std::atomic_bool m_available;
 		size_t m_thread_reserved = 0;
@@ -44,6 +49,8 @@ namespace Noodles
 		Implement::GobalComponentPool gobal_component_pool;
 		Implement::EventPool event_pool;
 		Implement::SystemPool system_pool;
+		std::atomic_size_t m_frame_count;
+		std::vector<std::unique_ptr<Implement::FrameMemoryResource>> m_frame_resources;
 		std::mutex m_asynchronous_works_mutex;
 		std::deque<intrusive_ptr<Implement::AsynchronousWorkInterface>> m_asynchronous_works;
 		std::mutex m_exception_mutex;
@@ -3,12 +3,13 @@
 #include "interface/entity_interface.h"
 #include "interface/event_interface.h"
 #include "interface/system_interface.h"
+#include <memory_resource>
 
 namespace Noodles
 {
 	struct Context
 	{
-		Entity create_entity() { return Entity{ create_entity_imp() }; }
+		Entity create_entity();
 		template<typename CompT, typename ...Parameter> std::remove_reference_t<std::remove_const_t<CompT>>& create_component(Entity entity, Parameter&& ...p);
 		template<typename CompT, typename ...Parameter> std::remove_reference_t<std::remove_const_t<CompT>>& create_gobal_component(Parameter&& ...p);
 		template<typename SystemT, typename ...Parameter> std::remove_reference_t<std::remove_const_t<SystemT>>& create_system(Parameter&& ...p);
@@ -16,16 +17,33 @@ namespace Noodles
 		template<typename SystemT, typename ...Parameter> std::remove_reference_t<std::remove_const_t<SystemT>>& create_temporary_system(Parameter&& ...p);
 		template<typename SystemT> void create_temporary_system(SystemT&& p, TickPriority priority = TickPriority::Normal, TickPriority layout = TickPriority::Normal);
 		template<typename SystemT> void destory_system();
+		// applied at the next update, returns whether the entity held CompT at the call, so the changes of this tick are not seen
+		// and a second call in the same tick returns true again
 		template<typename CompT> bool destory_component(Entity entity);
 		template<typename CompT> void destory_gobal_component();
+		// applied at the next update, keeps room for count entities holding exactly CompT...
+		template<typename ...CompT> void reserve(size_t count);
+		template<typename ...CompT> void shrink_to_fit();
+		// count entities holding exactly CompT..., value-initialized components are passed to init(Entity, CompT&...) in place, applied at the next update
+		template<typename ...CompT, typename Func> void create_entities(size_t count, Func&& init);
+		template<typename ...CompT> void create_entities(size_t count) { create_entities<CompT...>(count, [](Entity, CompT&...) {}); }
+		// applied at the next update after other changes, destory every entity holding CompT... by dropping whole storage blocks
+		template<typename ...CompT> void destory_all();
+		// every entity the filter could visit, disabled components are not checked
+		template<typename ...CompT> void destory_all(const Filter<CompT...>&) {
+			static_assert(Potato::Tmp::bool_and<true, std::is_same_v<typename Implement::ComponentFilterDetector<CompT>::type, CompT>...>::value, "destory_all does not accept filter with Changed or Added!");
+			destory_all<CompT...>();
+		}
 		void destory_entity(Entity entity) {
 			assert(entity);
 			Implement::ComponentPoolInterface* CPI = *this;
 			assert(entity);
-			CPI->entity_destory(entity.m_imp);
+			CPI->entity_destory(entity.m_id);
 		}
 		virtual void exit() noexcept = 0;
 		virtual float duration_s() const noexcept = 0;
+		// scratch memory of the calling worker thread, released as a whole at the next tick.
+		virtual std::pmr::memory_resource* frame_allocator() noexcept = 0;
 		template<typename CallableObject, typename ...Parameter> void insert_asynchronous_work(CallableObject&& co, Parameter&& ... pa);
 	private:
 		virtual void insert_asynchronous_work_imp(Implement::AsynchronousWorkInterface* ptr) = 0;
@@ -35,9 +53,16 @@ namespace Noodles
 		virtual operator Implement::GobalComponentPoolInterface* () = 0;
 		virtual operator Implement::EventPoolInterface* () = 0;
 		virtual operator Implement::SystemPoolInterface* () = 0;
-		virtual Implement::EntityInterfacePtr create_entity_imp() = 0;
 	};
 
+	inline Entity Context::create_entity()
+	{
+		Implement::ComponentPoolInterface* cp = *this;
+		Implement::EntityId id;
+		cp->allocate_entity(&id, 1);
+		return Entity{ cp->entity_table(), id };
+	}
+
 	template<typename CallableObject, typename ...Parameter> void Context::insert_asynchronous_work(CallableObject&& co, Parameter&& ... pa)
 	{
 		intrusive_ptr<Implement::AsynchronousWorkInterface> ptr = new Implement::AsynchronousWorkImplement<CallableObject, Parameter...>{
@@ -56,14 +81,51 @@ namespace Noodles
 	{
 		Implement::ComponentPoolInterface* cp = *this;
 		assert(entity);
-		return cp->construction_component<CompT>(entity.m_imp, std::forward<Parameter>(p)...);
+		return cp->construction_component<CompT>(entity.m_id, std::forward<Parameter>(p)...);
 	}
 
 	template<typename CompT> bool Context::destory_component(Entity entity)
 	{
 		Implement::ComponentPoolInterface* cp = *this;
 		assert(entity);
-		return cp->deconstruct_component(entity.m_imp, TypeInfo::create<CompT>());
+		bool exist = entity.have<CompT>();
+		// still queued, the component may be created in this tick
+		cp->deconstruct_component(entity.m_id, TypeInfo::create<CompT>());
+		return exist;
+	}
+
+	template<typename ...CompT> void Context::reserve(size_t count)
+	{
+		static_assert(sizeof...(CompT) > 0);
+		Implement::ComponentPoolInterface* cp = *this;
+		TypeInfo layouts[] = { TypeInfo::create<std::remove_const_t<CompT>>()... };
+		cp->reserve_type_group(layouts, sizeof...(CompT), count);
+	}
+
+	template<typename ...CompT, typename Func> void Context::create_entities(size_t count, Func&& init)
+	{
+		static_assert(sizeof...(CompT) > 0);
+		Implement::ComponentPoolInterface* cp = *this;
+		std::vector<Implement::EntityId> entities(count);
+		cp->allocate_entity(entities.data(), count);
+		cp->construction_components<std::remove_const_t<CompT>...>(entities.data(), count, std::forward<Func>(init));
+	}
+
+	template<typename ...CompT> void Context::destory_all()
+	{
+		static_assert(sizeof...(CompT) > 0);
+		static_assert(!Potato::Tmp::bool_or<false, Implement::ComponentStorageDetector<CompT>::sparse...>::value, "destory_all does not accept sparse component!");
+		Implement::ComponentPoolInterface* cp = *this;
+		TypeInfo layouts[] = { TypeInfo::create<std::remove_const_t<CompT>>()... };
+		cp->destory_type_groups(layouts, sizeof...(CompT));
+	}
+
+	template<typename ...CompT> void Context::shrink_to_fit()
+	{
+		static_assert(sizeof...(CompT) > 0);
+		Implement::ComponentPoolInterface* cp = *this;
+		TypeInfo layouts[] = { TypeInfo::create<std::remove_const_t<CompT>>()... };
+		cp->shrink_type_group(layouts, sizeof...(CompT));
 	}
 
 	template<typename CompT, typename ...Parameter> std::remove_reference_t<std::remove_const_t<CompT>>& Context::create_gobal_component(Parameter&& ...p)